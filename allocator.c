@@ -0,0 +1,326 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#define _GNU_SOURCE
+
+#include "allocator.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Blocks in each pool are 16, 32, 64, or 128 bytes
+#define MIN_BLOCK_SHIFT 4
+#define NUM_POOLS 4
+
+// Slab header, at the start of the slab, followed by its blocks
+typedef struct slab {
+    struct slab *next;    // Neighbors in the pool's list of partly or completely used slabs
+    struct slab *prev;
+    struct pool *pool;
+    void *free_list;    // Freed blocks, each holding a pointer to the next
+    unsigned live;
+    unsigned capacity;
+    unsigned bump;    // Blocks from here to 'capacity' have never been handed out
+} slab_t;
+
+typedef struct pool {
+    size_t block_size;
+    slab_t *partial;    // Slabs with free blocks
+    slab_t *full;
+    slab_t *spare;    // One empty slab kept so that alloc/free at a boundary doesn't thrash
+    unsigned num_slabs;
+} pool_t;
+
+typedef struct {
+    const char *name;
+    void *(*alloc)(mem_subsystem_t sub, size_t size);
+    void *(*realloc)(mem_subsystem_t sub, void *ptr, size_t old_size, size_t new_size);
+    void (*free)(mem_subsystem_t sub, void *ptr, size_t size);
+} mem_backend_t;
+
+typedef struct {
+    const mem_backend_t *backend;
+    pool_t pools[NUM_POOLS];
+    size_t large_bytes;    // Held in blocks too large for a pool
+    size_t live_bytes;
+    size_t peak_bytes;
+    unsigned long long allocs;
+    unsigned long long frees;
+    unsigned long long failures;
+} subsystem_t;
+
+static const char *subsystem_names[NUM_MEM_SUBSYSTEMS] = {"strings", "jobs"};
+
+static subsystem_t subsystems[NUM_MEM_SUBSYSTEMS];
+
+// Blocks start after the header, rounded up to keep them 16-byte aligned
+#define SLAB_HEADER_SIZE ((sizeof(slab_t) + 15) & ~(size_t) 15)
+
+static void slab_list_push(slab_t **head, slab_t *slab) {
+    slab->prev = NULL;
+    slab->next = *head;
+    if (*head != NULL) {
+        (*head)->prev = slab;
+    }
+    *head = slab;
+}
+
+static void slab_list_remove(slab_t **head, slab_t *slab) {
+    if (slab->prev != NULL) {
+        slab->prev->next = slab->next;
+    } else {
+        *head = slab->next;
+    }
+    if (slab->next != NULL) {
+        slab->next->prev = slab->prev;
+    }
+}
+
+static void *pool_alloc(pool_t *pool) {
+    slab_t *slab = pool->partial;
+    if (slab == NULL) {
+        if (pool->spare != NULL) {
+            slab = pool->spare;
+            pool->spare = NULL;
+        } else {
+            if ((slab = aligned_alloc(MEM_SLAB_SIZE, MEM_SLAB_SIZE)) == NULL) {
+                return NULL;
+            }
+            slab->pool = pool;
+            slab->free_list = NULL;
+            slab->live = 0;
+            slab->bump = 0;
+            slab->capacity = (MEM_SLAB_SIZE - SLAB_HEADER_SIZE) / pool->block_size;
+            pool->num_slabs++;
+        }
+        slab_list_push(&pool->partial, slab);
+    }
+
+    void *block = slab->free_list;
+    if (block != NULL) {
+        slab->free_list = *(void **) block;
+    } else {
+        block = (char *) slab + SLAB_HEADER_SIZE + slab->bump++ * pool->block_size;
+    }
+    if (++slab->live == slab->capacity) {
+        slab_list_remove(&pool->partial, slab);
+        slab_list_push(&pool->full, slab);
+    }
+    return block;
+}
+
+static void pool_free(void *block) {
+    slab_t *slab = (slab_t *) ((uintptr_t) block & ~(uintptr_t) (MEM_SLAB_SIZE - 1));
+    pool_t *pool = slab->pool;
+    if (slab->live == slab->capacity) {
+        slab_list_remove(&pool->full, slab);
+        slab_list_push(&pool->partial, slab);
+    }
+    *(void **) block = slab->free_list;
+    slab->free_list = block;
+
+    if (--slab->live == 0) {
+        slab_list_remove(&pool->partial, slab);
+        if (pool->spare == NULL) {
+            slab->free_list = NULL;
+            slab->bump = 0;
+            pool->spare = slab;
+        } else {
+            free(slab);
+            pool->num_slabs--;
+        }
+    }
+}
+
+static void pool_release(pool_t *pool) {
+    slab_t *lists[] = {pool->partial, pool->full, pool->spare};
+    for (int i = 0; i < 3; i++) {
+        slab_t *slab = lists[i];
+        while (slab != NULL) {
+            slab_t *next = i < 2 ? slab->next : NULL;
+            free(slab);
+            slab = next;
+        }
+    }
+    pool->partial = NULL;
+    pool->full = NULL;
+    pool->spare = NULL;
+    pool->num_slabs = 0;
+}
+
+// Index of the smallest pool whose blocks hold 'size' bytes, or -1 if the block is too large
+static int pool_index(size_t size) {
+    if (size > MEM_MAX_SLAB_BLOCK) {
+        return -1;
+    }
+    int i = 0;
+    while ((size_t) 1 << (MIN_BLOCK_SHIFT + i) < size) {
+        i++;
+    }
+    return i;
+}
+
+static void *slab_alloc(mem_subsystem_t sub, size_t size) {
+    int i = pool_index(size);
+    if (i == -1) {
+        void *block = malloc(size);
+        if (block != NULL) {
+            subsystems[sub].large_bytes += size;
+        }
+        return block;
+    }
+    return pool_alloc(&subsystems[sub].pools[i]);
+}
+
+static void slab_free(mem_subsystem_t sub, void *ptr, size_t size) {
+    if (pool_index(size) == -1) {
+        subsystems[sub].large_bytes -= size;
+        free(ptr);
+    } else {
+        pool_free(ptr);
+    }
+}
+
+static void *slab_realloc(mem_subsystem_t sub, void *ptr, size_t old_size, size_t new_size) {
+    int old_pool = pool_index(old_size);
+    int new_pool = pool_index(new_size);
+    if (old_pool == -1 && new_pool == -1) {
+        void *block = realloc(ptr, new_size);
+        if (block != NULL) {
+            subsystems[sub].large_bytes += new_size - old_size;
+        }
+        return block;
+    } else if (old_pool != -1 && old_pool == new_pool) {
+        return ptr;
+    }
+
+    void *block = slab_alloc(sub, new_size);
+    if (block != NULL) {
+        memcpy(block, ptr, old_size < new_size ? old_size : new_size);
+        slab_free(sub, ptr, old_size);
+    }
+    return block;
+}
+
+static void *system_alloc(mem_subsystem_t sub, size_t size) {
+    return malloc(size);
+}
+
+static void *system_realloc(mem_subsystem_t sub, void *ptr, size_t old_size, size_t new_size) {
+    return realloc(ptr, new_size);
+}
+
+static void system_free(mem_subsystem_t sub, void *ptr, size_t size) {
+    free(ptr);
+}
+
+static const mem_backend_t backends[] = {
+    {"slab", slab_alloc, slab_realloc, slab_free},
+    {"malloc", system_alloc, system_realloc, system_free},
+};
+
+int mem_init(void) {
+    const mem_backend_t *backend = &backends[0];
+    const char *name = getenv("SWISH_ALLOCATOR");
+    if (name != NULL && name[0] != '\0') {
+        backend = NULL;
+        for (size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); i++) {
+            if (strcmp(name, backends[i].name) == 0) {
+                backend = &backends[i];
+            }
+        }
+        if (backend == NULL) {
+            fprintf(stderr, "Unknown allocator: %s\n", name);
+            return -1;
+        }
+    }
+
+    for (int sub = 0; sub < NUM_MEM_SUBSYSTEMS; sub++) {
+        subsystems[sub].backend = backend;
+        for (int i = 0; i < NUM_POOLS; i++) {
+            subsystems[sub].pools[i].block_size = (size_t) 1 << (MIN_BLOCK_SHIFT + i);
+        }
+    }
+    return 0;
+}
+
+void mem_cleanup(void) {
+    for (int sub = 0; sub < NUM_MEM_SUBSYSTEMS; sub++) {
+        for (int i = 0; i < NUM_POOLS; i++) {
+            pool_release(&subsystems[sub].pools[i]);
+        }
+    }
+}
+
+static void account_alloc(subsystem_t *s, size_t size) {
+    s->live_bytes += size;
+    if (s->live_bytes > s->peak_bytes) {
+        s->peak_bytes = s->live_bytes;
+    }
+}
+
+void *mem_alloc(mem_subsystem_t sub, size_t size) {
+    subsystem_t *s = &subsystems[sub];
+    void *block = s->backend->alloc(sub, size);
+    if (block == NULL) {
+        s->failures++;
+        return NULL;
+    }
+    s->allocs++;
+    account_alloc(s, size);
+    return block;
+}
+
+void *mem_realloc(mem_subsystem_t sub, void *ptr, size_t old_size, size_t new_size) {
+    subsystem_t *s = &subsystems[sub];
+    void *block = s->backend->realloc(sub, ptr, old_size, new_size);
+    if (block == NULL) {
+        s->failures++;
+        return NULL;
+    }
+    s->live_bytes -= old_size;
+    account_alloc(s, new_size);
+    return block;
+}
+
+void mem_free(mem_subsystem_t sub, void *ptr, size_t size) {
+    if (ptr == NULL) {
+        return;
+    }
+    subsystem_t *s = &subsystems[sub];
+    s->backend->free(sub, ptr, size);
+    s->frees++;
+    s->live_bytes -= size;
+}
+
+// Bytes a subsystem's backend holds from the system
+static size_t reserved_bytes(const subsystem_t *s) {
+    if (s->backend->alloc != slab_alloc) {
+        return s->live_bytes;
+    }
+    size_t bytes = s->large_bytes;
+    for (int i = 0; i < NUM_POOLS; i++) {
+        bytes += (size_t) s->pools[i].num_slabs * MEM_SLAB_SIZE;
+    }
+    return bytes;
+}
+
+int mem_command(const strvec_t *tokens) {
+    if (tokens->length != 1) {
+        fprintf(stderr, "memstats: Usage: memstats\n");
+        return -1;
+    }
+    printf("%-10s %-8s %10s %10s %10s %10s %10s\n", "subsystem", "backend", "live", "peak",
+           "allocs", "frees", "reserved");
+    for (int sub = 0; sub < NUM_MEM_SUBSYSTEMS; sub++) {
+        const subsystem_t *s = &subsystems[sub];
+        printf("%-10s %-8s %10zu %10zu %10llu %10llu %10zu\n", subsystem_names[sub],
+               s->backend->name, s->live_bytes, s->peak_bytes, s->allocs, s->frees,
+               reserved_bytes(s));
+        if (s->failures > 0) {
+            printf("%-10s %llu failed allocations\n", "", s->failures);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,77 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#include <stddef.h>
+
+#include "string_vector.h"
+
+// Parts of the shell whose memory is accounted for separately
+typedef enum {
+    MEM_STRINGS,    // String vectors: token arrays and the strings in them
+    MEM_JOBS,       // Job list nodes
+    NUM_MEM_SUBSYSTEMS,
+} mem_subsystem_t;
+
+// Slabs are this size and aligned to it, so a block's slab is found from its address
+#define MEM_SLAB_SIZE 16384
+// Blocks up to this size come from slabs; larger ones from malloc()
+#define MEM_MAX_SLAB_BLOCK 128
+
+/*
+ * Choose the backend for every subsystem: "slab" (the default), which serves
+ * small blocks from per-subsystem pools of fixed-size blocks, or "malloc",
+ * which passes every request to the C library (e.g., to debug with valgrind).
+ * The choice is read from SWISH_ALLOCATOR. Must be called before any other
+ * function here.
+ * Returns 0 on success or -1 if SWISH_ALLOCATOR names no backend
+ */
+int mem_init(void);
+
+/*
+ * Return all slabs to the system. Any block still allocated from a slab
+ * becomes invalid.
+ */
+void mem_cleanup(void);
+
+/*
+ * Allocate memory on behalf of a subsystem. Not thread-safe: only the shell's
+ * main thread may allocate through this interface.
+ * sub: The subsystem the memory is for
+ * size: Number of bytes to allocate
+ * Returns the new block, or NULL on error
+ */
+void *mem_alloc(mem_subsystem_t sub, size_t size);
+
+/*
+ * Resize a block allocated with mem_alloc(), keeping its contents
+ * sub: The subsystem the block was allocated for
+ * ptr: The block
+ * old_size: The block's size as it was allocated
+ * new_size: The size to change it to
+ * Returns the resized block, or NULL on error, in which case 'ptr' is
+ * unchanged
+ */
+void *mem_realloc(mem_subsystem_t sub, void *ptr, size_t old_size, size_t new_size);
+
+/*
+ * Free a block allocated with mem_alloc()
+ * sub: The subsystem the block was allocated for
+ * ptr: The block, or NULL to do nothing
+ * size: The block's size as it was allocated; the slab backend uses it to
+ *   find the block's pool
+ */
+void mem_free(mem_subsystem_t sub, void *ptr, size_t size);
+
+/*
+ * The "memstats" builtin: memstats
+ * Prints, for each subsystem, its backend, the bytes it has allocated now and
+ * at most, its allocation and free counts, and the bytes its backend holds
+ * from the system
+ * tokens: Tokens typed by the user
+ * Returns 0 on success or -1 on error
+ */
+int mem_command(const strvec_t *tokens);
+
+#endif    // ALLOCATOR_H
@@ -0,0 +1,428 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#define _GNU_SOURCE
+
+#include "completion.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "swish_funcs.h"
+#include "variables.h"
+
+// Node of a trie of program names. Children form a list of siblings sorted by character,
+// so a node is 12 bytes however many children it has.
+typedef struct {
+    uint32_t child;      // First child, or 0 for none (node 0 is the root)
+    uint32_t sibling;    // Next sibling, or 0 for none
+    unsigned char c;
+    unsigned char terminal;    // A program's name ends here
+} trie_node_t;
+
+typedef struct {
+    char *dir;
+    int exists;
+    struct timespec mtime;
+} path_dir_t;
+
+typedef struct {
+    char *path;    // The value of PATH the index was built from
+    path_dir_t *dirs;
+    unsigned num_dirs;
+    trie_node_t *nodes;
+    uint32_t num_nodes;
+    uint32_t nodes_cap;
+} path_index_t;
+
+static struct {
+    const job_list_t *jobs;
+    path_index_t index;
+    pthread_t builder;
+    int building;    // The builder thread has not been joined yet
+    int build_status;
+} completion;
+
+static int trie_insert(path_index_t *idx, const char *name) {
+    // Reserve room for the whole name first, so that 'link' is not left dangling by realloc()
+    size_t len = strlen(name);
+    if (idx->num_nodes + len > idx->nodes_cap) {
+        uint32_t cap = idx->nodes_cap * 2;
+        while (cap < idx->num_nodes + len) {
+            cap *= 2;
+        }
+        trie_node_t *nodes = realloc(idx->nodes, cap * sizeof(trie_node_t));
+        if (nodes == NULL) {
+            return -1;
+        }
+        idx->nodes = nodes;
+        idx->nodes_cap = cap;
+    }
+
+    uint32_t node = 0;
+    for (const unsigned char *p = (const unsigned char *) name; *p != '\0'; p++) {
+        uint32_t *link = &idx->nodes[node].child;
+        while (*link != 0 && idx->nodes[*link].c < *p) {
+            link = &idx->nodes[*link].sibling;
+        }
+        if (*link == 0 || idx->nodes[*link].c != *p) {
+            uint32_t added = idx->num_nodes++;
+            idx->nodes[added].child = 0;
+            idx->nodes[added].sibling = *link;
+            idx->nodes[added].c = *p;
+            idx->nodes[added].terminal = 0;
+            *link = added;
+        }
+        node = *link;
+    }
+    idx->nodes[node].terminal = 1;
+    return 0;
+}
+
+// Find the node reached by following 'prefix' from the root
+// Returns the node, or -1 if no name starts with 'prefix'
+static int64_t trie_find(const path_index_t *idx, const char *prefix, size_t len) {
+    uint32_t node = 0;
+    for (size_t i = 0; i < len; i++) {
+        uint32_t child = idx->nodes[node].child;
+        while (child != 0 && idx->nodes[child].c != (unsigned char) prefix[i]) {
+            child = idx->nodes[child].sibling;
+        }
+        if (child == 0) {
+            return -1;
+        }
+        node = child;
+    }
+    return node;
+}
+
+// Add every name below 'node' to 'out'; 'buf' holds the first 'len' characters of the names
+static int trie_collect(const path_index_t *idx, uint32_t node, char *buf, size_t len,
+                        strvec_t *out) {
+    if (idx->nodes[node].terminal) {
+        buf[len] = '\0';
+        if (strvec_add(out, buf) == -1) {
+            return -1;
+        }
+    }
+    for (uint32_t child = idx->nodes[node].child; child != 0 && len < NAME_MAX;
+         child = idx->nodes[child].sibling) {
+        buf[len] = idx->nodes[child].c;
+        if (trie_collect(idx, child, buf, len + 1, out) == -1) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void index_free(path_index_t *idx) {
+    for (unsigned i = 0; i < idx->num_dirs; i++) {
+        free(idx->dirs[i].dir);
+    }
+    free(idx->dirs);
+    free(idx->nodes);
+    free(idx->path);
+    memset(idx, 0, sizeof(*idx));
+}
+
+// Add the executable files in one directory to the index
+static int index_dir(path_index_t *idx, const char *dir) {
+    DIR *d = opendir(dir);
+    if (d == NULL) {
+        return 0;
+    }
+    int status = 0;
+    struct dirent *entry;
+    while (status == 0 && (entry = readdir(d)) != NULL) {
+        if (entry->d_name[0] == '.' || entry->d_type == DT_DIR) {
+            continue;
+        }
+        struct stat st;
+        if (entry->d_type != DT_REG &&
+            (fstatat(dirfd(d), entry->d_name, &st, 0) == -1 || !S_ISREG(st.st_mode))) {
+            continue;
+        }
+        if (faccessat(dirfd(d), entry->d_name, X_OK, 0) == 0) {
+            status = trie_insert(idx, entry->d_name);
+        }
+    }
+    closedir(d);
+    return status;
+}
+
+// Read every directory on idx->path into the index
+static int index_build(path_index_t *idx) {
+    idx->nodes_cap = 1024;
+    idx->nodes = malloc(idx->nodes_cap * sizeof(trie_node_t));
+    if (idx->nodes == NULL) {
+        return -1;
+    }
+    memset(&idx->nodes[0], 0, sizeof(trie_node_t));
+    idx->num_nodes = 1;
+
+    unsigned max_dirs = 1;
+    for (const char *p = idx->path; *p != '\0'; p++) {
+        max_dirs += *p == ':';
+    }
+    if ((idx->dirs = calloc(max_dirs, sizeof(path_dir_t))) == NULL) {
+        return -1;
+    }
+
+    for (const char *dir = idx->path; *dir != '\0';) {
+        size_t len = strcspn(dir, ":");
+        if (len > 0) {
+            path_dir_t *entry = &idx->dirs[idx->num_dirs];
+            if ((entry->dir = strndup(dir, len)) == NULL) {
+                return -1;
+            }
+            idx->num_dirs++;
+            struct stat st;
+            if (stat(entry->dir, &st) == 0) {
+                entry->exists = 1;
+                entry->mtime = st.st_mtim;
+            }
+            if (entry->exists && index_dir(idx, entry->dir) == -1) {
+                return -1;
+            }
+        }
+        dir += len + (dir[len] == ':');
+    }
+    return 0;
+}
+
+static void *build_thread(void *arg) {
+    completion.build_status = index_build(&completion.index);
+    return NULL;
+}
+
+static const char *current_path(void) {
+    const char *path = vars_get("PATH");
+    return path != NULL ? path : DEFAULT_PATH;
+}
+
+int completion_init(const job_list_t *jobs) {
+    completion.jobs = jobs;
+    // The variable table is not thread-safe, so the thread gets its own copy of PATH
+    if ((completion.index.path = strdup(current_path())) == NULL) {
+        perror("strdup");
+        return -1;
+    }
+    int err = pthread_create(&completion.builder, NULL, build_thread, NULL);
+    if (err != 0) {
+        fprintf(stderr, "pthread_create: %s\n", strerror(err));
+        // Build the index on first use instead
+        completion.build_status = -1;
+        return -1;
+    }
+    completion.building = 1;
+    return 0;
+}
+
+void completion_free(void) {
+    if (completion.building) {
+        pthread_join(completion.builder, NULL);
+        completion.building = 0;
+    }
+    index_free(&completion.index);
+}
+
+// Whether the index no longer matches PATH or its directories
+static int index_is_stale(const path_index_t *idx) {
+    if (strcmp(idx->path, current_path()) != 0) {
+        return 1;
+    }
+    for (unsigned i = 0; i < idx->num_dirs; i++) {
+        struct stat st;
+        int exists = stat(idx->dirs[i].dir, &st) == 0;
+        if (exists != idx->dirs[i].exists) {
+            return 1;
+        }
+        // Only a change since the build counts; a timestamp in the future is left alone
+        if (exists && (st.st_mtim.tv_sec != idx->dirs[i].mtime.tv_sec ||
+                       st.st_mtim.tv_nsec != idx->dirs[i].mtime.tv_nsec)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Make sure the PATH index is built and current
+static int index_refresh(void) {
+    if (completion.building) {
+        pthread_join(completion.builder, NULL);
+        completion.building = 0;
+    }
+    if (completion.build_status == 0 && !index_is_stale(&completion.index)) {
+        return 0;
+    }
+    index_free(&completion.index);
+    if ((completion.index.path = strdup(current_path())) == NULL) {
+        perror("strdup");
+        completion.build_status = -1;
+        return -1;
+    }
+    completion.build_status = index_build(&completion.index);
+    if (completion.build_status == -1) {
+        perror("Failed to index PATH");
+    }
+    return completion.build_status;
+}
+
+static int complete_command(const char *word, size_t len, strvec_t *out) {
+    const char *builtin;
+    for (unsigned i = 0; (builtin = builtin_name(i)) != NULL; i++) {
+        if (strncmp(builtin, word, len) == 0 && strvec_add(out, builtin) == -1) {
+            return -1;
+        }
+    }
+    if (index_refresh() == -1) {
+        return -1;
+    }
+    if (len > NAME_MAX) {
+        return 0;
+    }
+    int64_t node = trie_find(&completion.index, word, len);
+    if (node == -1) {
+        return 0;
+    }
+    char name[NAME_MAX + 1];
+    memcpy(name, word, len);
+    return trie_collect(&completion.index, node, name, len, out);
+}
+
+static int complete_job(const char *word, size_t len, strvec_t *out) {
+    for (unsigned i = 0; i < completion.jobs->length; i++) {
+        char index[16];
+        snprintf(index, sizeof(index), "%u", i);
+        if (strncmp(index, word, len) == 0 && strvec_add(out, index) == -1) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int complete_path(const char *word, size_t len, int executables_only, strvec_t *out) {
+    const char *slash = memrchr(word, '/', len);
+    size_t dir_len = slash != NULL ? slash - word + 1 : 0;
+    const char *base = word + dir_len;
+    size_t base_len = len - dir_len;
+
+    char *dir = strndup(word, dir_len);
+    if (dir == NULL) {
+        perror("strndup");
+        return -1;
+    }
+    DIR *d = opendir(dir_len > 0 ? dir : ".");
+    free(dir);
+    if (d == NULL) {
+        return 0;
+    }
+
+    int status = 0;
+    struct dirent *entry;
+    while (status == 0 && (entry = readdir(d)) != NULL) {
+        const char *name = entry->d_name;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0 ||
+            (name[0] == '.' && (base_len == 0 || base[0] != '.')) ||
+            strncmp(name, base, base_len) != 0) {
+            continue;
+        }
+        int is_dir = entry->d_type == DT_DIR;
+        struct stat st;
+        if ((entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN) &&
+            fstatat(dirfd(d), name, &st, 0) == 0) {
+            is_dir = S_ISDIR(st.st_mode);
+        }
+        if (executables_only && !is_dir && faccessat(dirfd(d), name, X_OK, 0) == -1) {
+            continue;
+        }
+
+        char *candidate;
+        if (asprintf(&candidate, "%.*s%s%s", (int) dir_len, word, name, is_dir ? "/" : "") ==
+            -1) {
+            perror("asprintf");
+            status = -1;
+        } else {
+            status = strvec_add(out, candidate);
+            free(candidate);
+        }
+    }
+    closedir(d);
+    return status;
+}
+
+static int is_separator(const char *word, size_t len) {
+    return (len == 1 && (*word == ';' || *word == '|' || *word == '&')) ||
+           (len == 2 && (strncmp(word, "&&", 2) == 0 || strncmp(word, "||", 2) == 0)) ||
+           word[len - 1] == ';';
+}
+
+static int compare_strings(const void *a, const void *b) {
+    return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+int completion_find(const char *line, size_t cursor, size_t *word_start, strvec_t *candidates) {
+    size_t start = cursor;
+    while (start > 0 && line[start - 1] != ' ' && line[start - 1] != '\t') {
+        start--;
+    }
+    *word_start = start;
+
+    // Find the words of the current command before the one being completed
+    const char *command = NULL;
+    size_t command_len = 0;
+    unsigned words_before = 0;
+    for (size_t i = 0; i < start;) {
+        size_t len = strcspn(line + i, " \t");
+        if (len == 0) {
+            i++;
+            continue;
+        }
+        if (is_separator(line + i, len)) {
+            words_before = 0;
+        } else if (words_before++ == 0) {
+            command = line + i;
+            command_len = len;
+        }
+        i += len;
+    }
+
+    const char *word = line + start;
+    size_t len = cursor - start;
+    int status;
+    if (words_before == 0) {
+        status = memchr(word, '/', len) != NULL ? complete_path(word, len, 1, candidates)
+                                                : complete_command(word, len, candidates);
+    } else if (words_before == 1 &&
+               ((command_len == 2 &&
+                 (strncmp(command, "fg", 2) == 0 || strncmp(command, "bg", 2) == 0)) ||
+                (command_len == 8 && strncmp(command, "wait-for", 8) == 0))) {
+        status = complete_job(word, len, candidates);
+    } else {
+        status = complete_path(word, len, 0, candidates);
+    }
+    if (status == -1) {
+        return -1;
+    }
+
+    // Sort, then move repeated names (e.g., a builtin also found on PATH) to the end and drop them
+    qsort(candidates->data, candidates->length, sizeof(char *), compare_strings);
+    unsigned distinct = 0;
+    for (unsigned i = 0; i < candidates->length; i++) {
+        if (distinct == 0 || strcmp(candidates->data[i], candidates->data[distinct - 1]) != 0) {
+            char *tmp = candidates->data[distinct];
+            candidates->data[distinct++] = candidates->data[i];
+            candidates->data[i] = tmp;
+        }
+    }
+    strvec_take(candidates, distinct);
+    return distinct;
+}
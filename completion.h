@@ -0,0 +1,39 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef COMPLETION_H
+#define COMPLETION_H
+
+#include <stddef.h>
+
+#include "job_list.h"
+#include "string_vector.h"
+
+/*
+ * Start building the index of programs on PATH in a background thread, so
+ * that the shell can prompt for input right away
+ * jobs: The shell's job list, used to complete job indices
+ * Returns 0 on success or -1 on error
+ */
+int completion_init(const job_list_t *jobs);
+
+/*
+ * Wait for the background index build, if any, and free the index
+ */
+void completion_free(void);
+
+/*
+ * Find the completions for the word that ends at 'cursor' in 'line'. The
+ * first word of a command completes to a builtin or a program on PATH, the
+ * word after fg, bg, or wait-for to a job index, and any other word to a file
+ * path (directories end in '/'). The PATH index is rebuilt first if PATH or
+ * the modification time of one of its directories has changed.
+ * line: The line being edited
+ * cursor: Offset in 'line' where the word to complete ends
+ * word_start: Set to the offset where the word to complete starts
+ * candidates: Empty vector to fill with the sorted, distinct completions.
+ *   Each is a full replacement for the word.
+ * Returns the number of completions found or -1 on error
+ */
+int completion_find(const char *line, size_t cursor, size_t *word_start, strvec_t *candidates);
+
+#endif    // COMPLETION_H
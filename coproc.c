@@ -0,0 +1,302 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#define _GNU_SOURCE
+
+#include "coproc.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "swish_funcs.h"
+
+#define COPROC_READ_SIZE 4096
+// How long a coprocess is given to exit once its output has ended, before it is signaled
+#define COPROC_EXIT_WAIT_MS 100
+
+void coproc_list_init(coproc_list_t *list) {
+    list->head = NULL;
+}
+
+static void coproc_destroy(coproc_t *coproc) {
+    close(coproc->fd);
+    free(coproc->in_buf);
+    free(coproc->out_buf);
+    free(coproc);
+}
+
+void coproc_list_free(coproc_list_t *list) {
+    coproc_t *current = list->head;
+    while (current != NULL) {
+        coproc_t *temp = current;
+        current = current->next;
+        coproc_destroy(temp);
+    }
+    list->head = NULL;
+}
+
+coproc_t *coproc_find(coproc_list_t *list, const char *name) {
+    for (coproc_t *current = list->head; current != NULL; current = current->next) {
+        if (strcmp(current->name, name) == 0) {
+            return current;
+        }
+    }
+    return NULL;
+}
+
+int coproc_start(coproc_list_t *list, job_list_t *jobs, strvec_t *tokens) {
+    if (tokens->length < 3) {
+        fprintf(stderr, "coproc: Usage: coproc NAME COMMAND [ARGS...]\n");
+        return -1;
+    }
+    const char *name = tokens->data[1];
+    if (strlen(name) >= NAME_LEN) {
+        fprintf(stderr, "coproc: Name is longer than %d characters: %s\n", NAME_LEN - 1, name);
+        return -1;
+    }
+    if (coproc_find(list, name) != NULL) {
+        fprintf(stderr, "coproc: %s is already running\n", name);
+        return -1;
+    }
+
+    coproc_t *coproc = calloc(1, sizeof(coproc_t));
+    if (coproc == NULL) {
+        perror("calloc");
+        return -1;
+    }
+    strcpy(coproc->name, name);
+
+    // The shell's end is close-on-exec so other commands do not hold it open
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) == -1) {
+        perror("socketpair");
+        free(coproc);
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("fork");
+        close(sv[0]);
+        close(sv[1]);
+        free(coproc);
+        return -1;
+    } else if (pid == 0) {
+        if (setpgid(0, 0) == -1) {
+            perror("setpgid");
+        }
+        if (dup2(sv[1], STDIN_FILENO) == -1 || dup2(sv[1], STDOUT_FILENO) == -1) {
+            perror("dup2");
+            exit(EXIT_FAILURE);
+        }
+
+        strvec_t command;
+        strvec_init(&command);
+        for (int i = 2; i < tokens->length; i++) {
+            if (strvec_add(&command, tokens->data[i]) == -1) {
+                exit(EXIT_FAILURE);
+            }
+        }
+        run_command(&command);
+        exit(EXIT_FAILURE);
+    }
+
+    if (setpgid(pid, pid) == -1 && errno != EACCES) {
+        perror("setpgid");
+    }
+    close(sv[1]);
+    coproc->pid = pid;
+    coproc->fd = sv[0];
+    coproc->next = list->head;
+    list->head = coproc;
+
+    if (job_list_add(jobs, pid, coproc->name, COPROC) == -1) {
+        perror("job_list_add");
+    }
+    return 0;
+}
+
+// Read whatever input is available without blocking
+// Returns 0 on success (including when no data was ready) or -1 on error
+static int coproc_fill(coproc_t *coproc) {
+    while (!coproc->eof) {
+        if (coproc->in_cap - coproc->in_len < COPROC_READ_SIZE) {
+            size_t cap = coproc->in_cap == 0 ? COPROC_READ_SIZE * 2 : coproc->in_cap * 2;
+            char *grown = realloc(coproc->in_buf, cap);
+            if (grown == NULL) {
+                perror("realloc");
+                return -1;
+            }
+            coproc->in_buf = grown;
+            coproc->in_cap = cap;
+        }
+
+        ssize_t n = recv(coproc->fd, coproc->in_buf + coproc->in_len,
+                         coproc->in_cap - coproc->in_len, MSG_DONTWAIT);
+        if (n > 0) {
+            coproc->in_len += n;
+        } else if (n == 0) {
+            coproc->eof = 1;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 0;
+        } else if (errno != EINTR) {
+            perror("recv");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Push all queued output into the socket. While the socket is full, keep
+// draining the coprocess's output so that it is never stuck writing to us
+// while we are stuck writing to it.
+static int coproc_flush(coproc_t *coproc) {
+    size_t sent = 0;
+    int status = 0;
+    while (sent < coproc->out_len) {
+        ssize_t n = send(coproc->fd, coproc->out_buf + sent, coproc->out_len - sent,
+                         MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n >= 0) {
+            sent += n;
+            continue;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            perror("send");
+            status = -1;
+            break;
+        }
+
+        struct pollfd pfd = {coproc->fd, coproc->eof ? POLLOUT : POLLIN | POLLOUT, 0};
+        if (poll(&pfd, 1, -1) == -1 && errno != EINTR) {
+            perror("poll");
+            status = -1;
+            break;
+        }
+        if ((pfd.revents & (POLLIN | POLLHUP)) && coproc_fill(coproc) == -1) {
+            status = -1;
+            break;
+        }
+    }
+
+    memmove(coproc->out_buf, coproc->out_buf + sent, coproc->out_len - sent);
+    coproc->out_len -= sent;
+    return status;
+}
+
+int coproc_send(coproc_t *coproc, const char *text) {
+    size_t len = strlen(text);
+    if (coproc->out_len + len + 1 > coproc->out_cap) {
+        size_t cap = coproc->out_cap == 0 ? COPROC_READ_SIZE : coproc->out_cap;
+        while (cap < coproc->out_len + len + 1) {
+            cap *= 2;
+        }
+        char *grown = realloc(coproc->out_buf, cap);
+        if (grown == NULL) {
+            perror("realloc");
+            return -1;
+        }
+        coproc->out_buf = grown;
+        coproc->out_cap = cap;
+    }
+    memcpy(coproc->out_buf + coproc->out_len, text, len);
+    coproc->out_buf[coproc->out_len + len] = '\n';
+    coproc->out_len += len + 1;
+
+    return coproc_flush(coproc);
+}
+
+int coproc_recv(coproc_t *coproc, char **line) {
+    if (coproc_flush(coproc) == -1) {
+        return -1;
+    }
+
+    while (1) {
+        char *nl = memchr(coproc->in_buf, '\n', coproc->in_len);
+        if (nl != NULL || (coproc->eof && coproc->in_len > 0)) {
+            size_t len = nl != NULL ? (size_t) (nl - coproc->in_buf) : coproc->in_len;
+            size_t consumed = nl != NULL ? len + 1 : len;
+            if ((*line = strndup(coproc->in_buf, len)) == NULL) {
+                perror("strndup");
+                return -1;
+            }
+            memmove(coproc->in_buf, coproc->in_buf + consumed, coproc->in_len - consumed);
+            coproc->in_len -= consumed;
+            return 0;
+        }
+        if (coproc->eof) {
+            return -1;
+        }
+
+        struct pollfd pfd = {coproc->fd, POLLIN, 0};
+        if (poll(&pfd, 1, -1) == -1 && errno != EINTR) {
+            perror("poll");
+            return -1;
+        }
+        if (coproc_fill(coproc) == -1) {
+            return -1;
+        }
+    }
+}
+
+// Reap a process if it exits within COPROC_EXIT_WAIT_MS
+// Returns 1 if it is gone (or was already collected), 0 if it is still running
+static int reap_within(pid_t pid) {
+    struct timespec step = {0, 1000000};
+    for (int i = 0; i < COPROC_EXIT_WAIT_MS; i++) {
+        int status;
+        pid_t ret = waitpid(pid, &status, WNOHANG);
+        if (ret == pid) {
+            return 1;
+        } else if (ret == -1 && errno != EINTR) {
+            if (errno != ECHILD) {
+                perror("waitpid");
+            }
+            return 1;
+        }
+        nanosleep(&step, NULL);
+    }
+    return 0;
+}
+
+void coproc_remove(coproc_list_t *list, job_list_t *jobs, coproc_t *coproc) {
+    if (list->head == coproc) {
+        list->head = coproc->next;
+    } else {
+        coproc_t *current = list->head;
+        while (current != NULL && current->next != coproc) {
+            current = current->next;
+        }
+        if (current != NULL) {
+            current->next = coproc->next;
+        }
+    }
+
+    // Closing our end gives the coprocess end-of-input if it is still reading. One that
+    // closed its output but keeps running is terminated rather than waited for.
+    pid_t pid = coproc->pid;
+    coproc_destroy(coproc);
+    if (!reap_within(pid)) {
+        kill(-pid, SIGTERM);
+        if (!reap_within(pid)) {
+            kill(-pid, SIGKILL);
+            while (waitpid(pid, NULL, 0) == -1 && errno == EINTR) {
+            }
+        }
+    }
+
+    unsigned idx = 0;
+    for (job_t *current = jobs->head; current != NULL; current = current->next, idx++) {
+        if (current->pid == pid) {
+            job_list_remove(jobs, idx);
+            break;
+        }
+    }
+}
@@ -0,0 +1,95 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef COPROC_H
+#define COPROC_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "job_list.h"
+#include "string_vector.h"
+
+/*
+ * A long-running child process started with "coproc NAME cmd". The shell
+ * talks to it through one end of a socket pair connected to the child's
+ * stdin and stdout. Both directions are buffered in the shell and use
+ * non-blocking socket calls so that neither side can deadlock the other.
+ */
+typedef struct coproc {
+    char name[NAME_LEN];
+    pid_t pid;
+    int fd;
+    char *in_buf;    // Received but not yet returned by coproc_recv()
+    size_t in_len;
+    size_t in_cap;
+    char *out_buf;    // Queued by coproc_send() but not yet accepted by the socket
+    size_t out_len;
+    size_t out_cap;
+    int eof;
+    struct coproc *next;
+} coproc_t;
+
+typedef struct {
+    coproc_t *head;
+} coproc_list_t;
+
+/*
+ * Initialize a new, empty coprocess list
+ * list: Pointer to the list to initialize
+ */
+void coproc_list_init(coproc_list_t *list);
+
+/*
+ * Close the shell's end of every coprocess and free the list. Coprocesses
+ * see end-of-input and are expected to exit on their own.
+ * list: Pointer to the list to free
+ */
+void coproc_list_free(coproc_list_t *list);
+
+/*
+ * Start a coprocess and register it in the job list with status COPROC.
+ * Fails if the name is already in use or has NAME_LEN or more characters.
+ * list: The shell's coprocess list
+ * jobs: The shell's job list
+ * tokens: Tokens typed by the user, e.g., "coproc CALC bc -l"
+ * Returns 0 on success or -1 on error
+ */
+int coproc_start(coproc_list_t *list, job_list_t *jobs, strvec_t *tokens);
+
+/*
+ * Look up a coprocess by name
+ * list: The shell's coprocess list
+ * name: Name given to the coprocess when it was started
+ * Returns a pointer to the coprocess (not a copy) or NULL if not found
+ */
+coproc_t *coproc_find(coproc_list_t *list, const char *name);
+
+/*
+ * Send one line of text to a coprocess's stdin
+ * coproc: The coprocess to send to
+ * text: Line to send; a trailing newline is added
+ * Returns 0 on success or -1 on error
+ */
+int coproc_send(coproc_t *coproc, const char *text);
+
+/*
+ * Receive one line from a coprocess's stdout, blocking until it is available
+ * coproc: The coprocess to receive from
+ * line: Set to a newly allocated copy of the line (without its newline),
+ *       which the caller must free
+ * Returns 0 on success, or -1 on error or once the coprocess has closed its
+ * output and no more lines are buffered
+ */
+int coproc_recv(coproc_t *coproc, char **line);
+
+/*
+ * Remove a coprocess whose output has ended: close its socket, reap it, and
+ * remove it from the job list. A coprocess still running shortly after its
+ * socket is closed is sent SIGTERM, and SIGKILL if that does not end it.
+ * list: The shell's coprocess list
+ * jobs: The shell's job list
+ * coproc: The coprocess to remove (freed by this function)
+ */
+void coproc_remove(coproc_list_t *list, job_list_t *jobs, coproc_t *coproc);
+
+#endif    // COPROC_H
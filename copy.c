@@ -0,0 +1,743 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#define _GNU_SOURCE
+
+#include "copy.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <limits.h>
+#include <linux/io_uring.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CHUNK_SIZE (128 * 1024)
+
+typedef struct {
+    const char *src;
+    char *dst;    // NULL when concatenating into the shared destination
+    mode_t mode;
+    off_t dst_offset;    // Where this file's data starts in the destination
+    off_t size;    // Bytes to copy when concatenating; -1 to copy until end of file
+} copy_file_t;
+
+typedef struct {
+    copy_file_t *files;
+    size_t num_files;
+    const char *dest;    // DEST as given by the user
+    int shared_fd;    // Destination when concatenating, otherwise -1
+    unsigned depth;
+    atomic_size_t next_file;
+    atomic_ullong bytes;
+    atomic_int failures;
+} copy_job_t;
+
+// Report an error for one file
+static void copy_error(copy_job_t *job, const char *path, int err) {
+    fprintf(stderr, "copy: %s: %s\n", path, strerror(err));
+    atomic_fetch_add(&job->failures, 1);
+}
+
+/* ---------------- io_uring engine ---------------- */
+
+typedef struct {
+    int fd;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned sq_entries;
+    unsigned sq_local_tail;    // Includes SQEs prepared but not yet published to the kernel
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ring;
+    size_t sq_ring_len;
+    void *cq_ring;
+    size_t cq_ring_len;
+    size_t sqes_len;
+} uring_t;
+
+typedef enum {
+    OPEN_SRC,
+    OPEN_DST,
+    READ,
+    WRITE,
+    CLOSE_SRC,
+    CLOSE_DST,
+} slot_state_t;
+
+// One file being copied through the ring. Each slot has at most one request in flight.
+typedef struct {
+    copy_file_t *file;
+    slot_state_t state;
+    int src_fd;
+    int dst_fd;
+    int owns_dst;
+    int failed;
+    off_t copied;
+    char *buf;
+    size_t buf_len;     // Bytes read into 'buf'
+    size_t buf_done;    // Bytes of 'buf' written so far
+} copy_slot_t;
+
+static void uring_unmap(uring_t *ring) {
+    if (ring->sqes != NULL && ring->sqes != MAP_FAILED) {
+        munmap(ring->sqes, ring->sqes_len);
+    }
+    if (ring->cq_ring != NULL && ring->cq_ring != MAP_FAILED && ring->cq_ring != ring->sq_ring) {
+        munmap(ring->cq_ring, ring->cq_ring_len);
+    }
+    if (ring->sq_ring != NULL && ring->sq_ring != MAP_FAILED) {
+        munmap(ring->sq_ring, ring->sq_ring_len);
+    }
+    close(ring->fd);
+}
+
+// Check that the kernel supports every operation the copy state machine uses
+static int uring_supports_ops(int fd) {
+    size_t len = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = calloc(1, len);
+    if (probe == NULL) {
+        return 0;
+    }
+    int supported = 0;
+    if (syscall(SYS_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) == 0) {
+        const int ops[] = {IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_WRITE, IORING_OP_CLOSE};
+        supported = 1;
+        for (int i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+            if (ops[i] > probe->last_op || !(probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED)) {
+                supported = 0;
+            }
+        }
+    }
+    free(probe);
+    return supported;
+}
+
+// Set up a ring with room for 'entries' requests
+// Returns 0 on success or -1 if io_uring cannot be used
+static int uring_init(uring_t *ring, unsigned entries) {
+    memset(ring, 0, sizeof(*ring));
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring->fd = syscall(SYS_io_uring_setup, entries, &params);
+    if (ring->fd == -1) {
+        return -1;
+    }
+    if (!uring_supports_ops(ring->fd)) {
+        close(ring->fd);
+        return -1;
+    }
+
+    ring->sq_ring_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_len = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_ring_len > ring->sq_ring_len) {
+            ring->sq_ring_len = ring->cq_ring_len;
+        }
+    }
+    ring->sq_ring = mmap(NULL, ring->sq_ring_len, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) {
+        uring_unmap(ring);
+        return -1;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ring = ring->sq_ring;
+    } else {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_len, PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ring == MAP_FAILED) {
+            uring_unmap(ring);
+            return -1;
+        }
+    }
+    ring->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        uring_unmap(ring);
+        return -1;
+    }
+
+    char *sq = ring->sq_ring;
+    char *cq = ring->cq_ring;
+    ring->sq_head = (unsigned *) (sq + params.sq_off.head);
+    ring->sq_tail = (unsigned *) (sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned *) (sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *) (sq + params.sq_off.array);
+    ring->sq_entries = params.sq_entries;
+    ring->sq_local_tail = *ring->sq_tail;
+    ring->cq_head = (unsigned *) (cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *) (cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned *) (cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *) (cq + params.cq_off.cqes);
+    return 0;
+}
+
+// Get a cleared SQE for a slot's next request. The ring always has room, since there are
+// at least as many SQEs as slots and each slot has at most one request in flight.
+static struct io_uring_sqe *uring_prep(uring_t *ring, copy_slot_t *slot, int opcode, int fd) {
+    unsigned idx = ring->sq_local_tail++ & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->user_data = (unsigned long long) (uintptr_t) slot;
+    ring->sq_array[idx] = idx;
+    return sqe;
+}
+
+// Publish all prepared SQEs and wait for at least one completion
+static int uring_submit_and_wait(uring_t *ring) {
+    __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+    while (1) {
+        // The kernel advances the head past every SQE it has consumed
+        unsigned to_submit = ring->sq_local_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+        if (syscall(SYS_io_uring_enter, ring->fd, to_submit, 1, IORING_ENTER_GETEVENTS, NULL, 0) !=
+            -1) {
+            return 0;
+        } else if (errno != EINTR) {
+            perror("io_uring_enter");
+            return -1;
+        }
+    }
+}
+
+// Wait for the completions of 'pending' requests the kernel has already taken, without
+// submitting any more, closing any files they opened
+// Returns 0 on success or -1 if the ring failed and requests may still be in flight
+static int uring_drain(uring_t *ring, unsigned pending) {
+    while (1) {
+        unsigned head = *ring->cq_head;
+        unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail && pending > 0; head++, pending--) {
+            struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+            copy_slot_t *slot = (copy_slot_t *) (uintptr_t) cqe->user_data;
+            if ((slot->state == OPEN_SRC || slot->state == OPEN_DST) && cqe->res >= 0) {
+                close(cqe->res);
+            }
+        }
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+        if (pending == 0) {
+            return 0;
+        }
+        if (syscall(SYS_io_uring_enter, ring->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) == -1 &&
+            errno != EINTR) {
+            return -1;
+        }
+    }
+}
+
+static void slot_prep_open(uring_t *ring, copy_slot_t *slot, const char *path, int flags,
+                           mode_t mode) {
+    struct io_uring_sqe *sqe = uring_prep(ring, slot, IORING_OP_OPENAT, AT_FDCWD);
+    sqe->addr = (unsigned long long) (uintptr_t) path;
+    sqe->open_flags = flags | O_CLOEXEC;
+    sqe->len = mode;
+}
+
+static void slot_prep_close(uring_t *ring, copy_slot_t *slot) {
+    if (slot->src_fd != -1) {
+        slot->state = CLOSE_SRC;
+        uring_prep(ring, slot, IORING_OP_CLOSE, slot->src_fd);
+        slot->src_fd = -1;
+    } else if (slot->owns_dst && slot->dst_fd != -1) {
+        slot->state = CLOSE_DST;
+        uring_prep(ring, slot, IORING_OP_CLOSE, slot->dst_fd);
+        slot->dst_fd = -1;
+    } else {
+        slot->file = NULL;
+    }
+}
+
+static void slot_prep_read(uring_t *ring, copy_slot_t *slot) {
+    size_t len = CHUNK_SIZE;
+    if (slot->file->size != -1) {
+        off_t remaining = slot->file->size - slot->copied;
+        if (remaining <= 0) {
+            slot_prep_close(ring, slot);
+            return;
+        }
+        if (remaining < len) {
+            len = remaining;
+        }
+    }
+    slot->state = READ;
+    struct io_uring_sqe *sqe = uring_prep(ring, slot, IORING_OP_READ, slot->src_fd);
+    sqe->addr = (unsigned long long) (uintptr_t) slot->buf;
+    sqe->len = len;
+    sqe->off = slot->copied;
+}
+
+static void slot_prep_write(uring_t *ring, copy_slot_t *slot) {
+    slot->state = WRITE;
+    struct io_uring_sqe *sqe = uring_prep(ring, slot, IORING_OP_WRITE, slot->dst_fd);
+    sqe->addr = (unsigned long long) (uintptr_t) (slot->buf + slot->buf_done);
+    sqe->len = slot->buf_len - slot->buf_done;
+    sqe->off = slot->file->dst_offset + slot->copied - (slot->buf_len - slot->buf_done);
+}
+
+static void slot_start(uring_t *ring, copy_job_t *job, copy_slot_t *slot, copy_file_t *file) {
+    slot->file = file;
+    slot->src_fd = -1;
+    slot->dst_fd = job->shared_fd;
+    slot->owns_dst = job->shared_fd == -1;
+    slot->failed = 0;
+    slot->copied = 0;
+    slot->state = OPEN_SRC;
+    slot_prep_open(ring, slot, file->src, O_RDONLY, 0);
+}
+
+static void slot_fail(copy_job_t *job, copy_slot_t *slot, const char *path, int err) {
+    if (!slot->failed) {
+        copy_error(job, path, err);
+        slot->failed = 1;
+    }
+}
+
+// Advance a slot's state machine with the result of its completed request
+static void slot_complete(uring_t *ring, copy_job_t *job, copy_slot_t *slot, int res) {
+    copy_file_t *file = slot->file;
+    switch (slot->state) {
+        case OPEN_SRC:
+            if (res < 0) {
+                slot_fail(job, slot, file->src, -res);
+                slot_prep_close(ring, slot);
+            } else if (slot->owns_dst) {
+                slot->src_fd = res;
+                slot->state = OPEN_DST;
+                slot_prep_open(ring, slot, file->dst, O_WRONLY | O_CREAT | O_TRUNC, file->mode);
+            } else {
+                slot->src_fd = res;
+                slot_prep_read(ring, slot);
+            }
+            break;
+        case OPEN_DST:
+            if (res < 0) {
+                slot_fail(job, slot, file->dst, -res);
+                slot_prep_close(ring, slot);
+            } else {
+                slot->dst_fd = res;
+                slot_prep_read(ring, slot);
+            }
+            break;
+        case READ:
+            if (res < 0) {
+                slot_fail(job, slot, file->src, -res);
+                slot_prep_close(ring, slot);
+            } else if (res == 0) {
+                slot_prep_close(ring, slot);
+            } else {
+                slot->buf_len = res;
+                slot->buf_done = 0;
+                slot->copied += res;
+                slot_prep_write(ring, slot);
+            }
+            break;
+        case WRITE:
+            if (res < 0) {
+                slot_fail(job, slot, file->dst != NULL ? file->dst : job->dest, -res);
+                slot_prep_close(ring, slot);
+                break;
+            }
+            slot->buf_done += res;
+            atomic_fetch_add(&job->bytes, res);
+            if (slot->buf_done < slot->buf_len) {
+                slot_prep_write(ring, slot);
+            } else {
+                slot_prep_read(ring, slot);
+            }
+            break;
+        case CLOSE_SRC:
+        case CLOSE_DST:
+            if (res < 0 && slot->state == CLOSE_DST) {
+                slot_fail(job, slot, file->dst, -res);
+            }
+            slot_prep_close(ring, slot);
+            break;
+    }
+}
+
+// Copy all files with io_uring
+// Returns 0 when done (individual files may have failed) or -1 if the ring could not be used
+static int copy_with_uring(copy_job_t *job) {
+    unsigned num_slots = job->depth < job->num_files ? job->depth : job->num_files;
+    uring_t ring;
+    if (uring_init(&ring, num_slots) == -1) {
+        return -1;
+    }
+
+    copy_slot_t *slots = calloc(num_slots, sizeof(copy_slot_t));
+    char *buffers = malloc((size_t) num_slots * CHUNK_SIZE);
+    if (slots == NULL || buffers == NULL) {
+        perror("malloc");
+        free(slots);
+        free(buffers);
+        uring_unmap(&ring);
+        return -1;
+    }
+
+    // Requests the kernel has taken, less those completed, are still in flight
+    unsigned first_sqe = __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE);
+    unsigned completed = 0;
+    size_t next_file = 0;
+    unsigned active = 0;
+    for (unsigned i = 0; i < num_slots; i++) {
+        slots[i].buf = buffers + (size_t) i * CHUNK_SIZE;
+        slot_start(&ring, job, &slots[i], &job->files[next_file++]);
+        active++;
+    }
+
+    int status = 0;
+    while (active > 0) {
+        if (uring_submit_and_wait(&ring) == -1) {
+            status = -1;
+            break;
+        }
+
+        unsigned head = *ring.cq_head;
+        unsigned tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            struct io_uring_cqe *cqe = &ring.cqes[head & *ring.cq_mask];
+            copy_slot_t *slot = (copy_slot_t *) (uintptr_t) cqe->user_data;
+            slot_complete(&ring, job, slot, cqe->res);
+            completed++;
+
+            // A slot whose file is finished moves on to the next file
+            if (slot->file == NULL) {
+                if (next_file < job->num_files) {
+                    slot_start(&ring, job, slot, &job->files[next_file++]);
+                } else {
+                    active--;
+                }
+            }
+        }
+        __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    if (status == -1) {
+        // Any remaining files are not copied
+        atomic_fetch_add(&job->failures, 1);
+
+        // Reads still in flight would land in the buffers after they were freed, so wait for
+        // them. If even that fails, the buffers are leaked rather than risk it.
+        unsigned taken = __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE) - first_sqe;
+        if (uring_drain(&ring, taken - completed) == -1) {
+            perror("io_uring_enter");
+            uring_unmap(&ring);
+            return 0;
+        }
+        for (unsigned i = 0; i < num_slots; i++) {
+            if (slots[i].file != NULL && slots[i].src_fd != -1) {
+                close(slots[i].src_fd);
+            }
+            if (slots[i].file != NULL && slots[i].owns_dst && slots[i].dst_fd != -1) {
+                close(slots[i].dst_fd);
+            }
+        }
+    }
+    free(buffers);
+    free(slots);
+    uring_unmap(&ring);
+    return 0;
+}
+
+/* ---------------- Thread pool fallback ---------------- */
+
+// Copy with pread()/pwrite() when copy_file_range() is not supported for a pair of files
+static int copy_read_write(copy_job_t *job, copy_file_t *file, int src_fd, int dst_fd,
+                           off_t copied, char *buf) {
+    while (file->size == -1 || copied < file->size) {
+        size_t len = CHUNK_SIZE;
+        if (file->size != -1 && file->size - copied < len) {
+            len = file->size - copied;
+        }
+        ssize_t n = pread(src_fd, buf, len, copied);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        } else if (n == -1) {
+            copy_error(job, file->src, errno);
+            return -1;
+        } else if (n == 0) {
+            break;
+        }
+
+        for (ssize_t done = 0; done < n;) {
+            ssize_t written = pwrite(dst_fd, buf + done, n - done, file->dst_offset + copied + done);
+            if (written == -1 && errno != EINTR) {
+                copy_error(job, file->dst != NULL ? file->dst : job->dest, errno);
+                return -1;
+            }
+            if (written > 0) {
+                done += written;
+                atomic_fetch_add(&job->bytes, written);
+            }
+        }
+        copied += n;
+    }
+    return 0;
+}
+
+static void copy_one(copy_job_t *job, copy_file_t *file, char *buf) {
+    int src_fd = open(file->src, O_RDONLY | O_CLOEXEC);
+    if (src_fd == -1) {
+        copy_error(job, file->src, errno);
+        return;
+    }
+    int dst_fd = job->shared_fd;
+    if (dst_fd == -1) {
+        dst_fd = open(file->dst, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, file->mode);
+        if (dst_fd == -1) {
+            copy_error(job, file->dst, errno);
+            close(src_fd);
+            return;
+        }
+    }
+
+    // Let the kernel move the data directly, falling back to reads and writes if it can't
+    off_t in_off = 0;
+    off_t out_off = file->dst_offset;
+    while (file->size == -1 || in_off < file->size) {
+        size_t len = file->size == -1 ? SSIZE_MAX : file->size - in_off;
+        ssize_t n = copy_file_range(src_fd, &in_off, dst_fd, &out_off, len, 0);
+        if (n > 0) {
+            atomic_fetch_add(&job->bytes, n);
+        } else if (n == 0) {
+            break;
+        } else if (errno != EINTR) {
+            if (errno == EXDEV || errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP ||
+                errno == EBADF) {
+                copy_read_write(job, file, src_fd, dst_fd, in_off, buf);
+            } else {
+                copy_error(job, file->src, errno);
+            }
+            break;
+        }
+    }
+
+    close(src_fd);
+    if (dst_fd != job->shared_fd && close(dst_fd) == -1) {
+        copy_error(job, file->dst, errno);
+    }
+}
+
+static void *copy_worker(void *arg) {
+    copy_job_t *job = arg;
+    char *buf = malloc(CHUNK_SIZE);
+    if (buf == NULL) {
+        perror("malloc");
+        return NULL;
+    }
+    size_t i;
+    while ((i = atomic_fetch_add(&job->next_file, 1)) < job->num_files) {
+        copy_one(job, &job->files[i], buf);
+    }
+    free(buf);
+    return NULL;
+}
+
+static int copy_with_threads(copy_job_t *job) {
+    unsigned num_threads = job->depth < job->num_files ? job->depth : job->num_files;
+    pthread_t *threads = malloc(num_threads * sizeof(pthread_t));
+    if (threads == NULL) {
+        perror("malloc");
+        return -1;
+    }
+
+    unsigned started = 0;
+    for (; started < num_threads; started++) {
+        int err = pthread_create(&threads[started], NULL, copy_worker, job);
+        if (err != 0) {
+            fprintf(stderr, "pthread_create: %s\n", strerror(err));
+            break;
+        }
+    }
+    // With no threads at all, do the work on this one
+    if (started == 0) {
+        copy_worker(job);
+    }
+    for (unsigned i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    return 0;
+}
+
+/* ---------------- The builtin ---------------- */
+
+static int same_file(const struct stat *a, const struct stat *b) {
+    return a->st_dev == b->st_dev && a->st_ino == b->st_ino;
+}
+
+// Work out the source and destination of every file to copy. Fails if any destination is
+// one of the sources, which would be truncated before it was read.
+// Returns 0 on success or -1 on error
+static int plan_copy(copy_job_t *job, char **srcs, size_t num_srcs, const char *dest,
+                     int concat) {
+    job->files = calloc(num_srcs, sizeof(copy_file_t));
+    if (job->files == NULL) {
+        perror("calloc");
+        return -1;
+    }
+    job->num_files = num_srcs;
+
+    struct stat dest_info;
+    int dest_exists = stat(dest, &dest_info) == 0;
+    int dest_is_dir = !concat && dest_exists && S_ISDIR(dest_info.st_mode);
+    if (!concat && !dest_is_dir && num_srcs > 1) {
+        fprintf(stderr, "copy: %s: Not a directory\n", dest);
+        return -1;
+    }
+
+    off_t offset = 0;
+    for (size_t i = 0; i < num_srcs; i++) {
+        copy_file_t *file = &job->files[i];
+        file->src = srcs[i];
+        struct stat info;
+        if (stat(file->src, &info) == -1) {
+            fprintf(stderr, "copy: %s: %s\n", file->src, strerror(errno));
+            return -1;
+        }
+        if (S_ISDIR(info.st_mode)) {
+            fprintf(stderr, "copy: %s: Is a directory\n", file->src);
+            return -1;
+        }
+        file->mode = info.st_mode & 0777;
+        file->size = -1;
+
+        if (concat) {
+            // Each file gets its own region of the destination, so all can be copied at once
+            if (!S_ISREG(info.st_mode)) {
+                fprintf(stderr, "copy: %s: Can only concatenate regular files\n", file->src);
+                return -1;
+            }
+            // The destination is truncated before anything is read from it
+            if (dest_exists && same_file(&info, &dest_info)) {
+                fprintf(stderr, "copy: %s and %s are the same file\n", file->src, dest);
+                return -1;
+            }
+            file->size = info.st_size;
+            file->dst_offset = offset;
+            offset += info.st_size;
+        } else if (dest_is_dir) {
+            char *base_copy = strdup(file->src);
+            if (base_copy == NULL ||
+                asprintf(&file->dst, "%s/%s", dest, basename(base_copy)) == -1) {
+                perror("asprintf");
+                file->dst = NULL;
+                free(base_copy);
+                return -1;
+            }
+            free(base_copy);
+        } else if ((file->dst = strdup(dest)) == NULL) {
+            perror("strdup");
+            return -1;
+        }
+
+        struct stat dst_info;
+        if (file->dst != NULL && stat(file->dst, &dst_info) == 0 && same_file(&info, &dst_info)) {
+            fprintf(stderr, "copy: %s and %s are the same file\n", file->src, file->dst);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int copy_command(const strvec_t *tokens) {
+    unsigned depth = COPY_DEFAULT_DEPTH;
+    int concat = 0;
+    int use_threads = 0;
+    int silent = 0;
+    unsigned i = 1;
+    for (; i < tokens->length && tokens->data[i][0] == '-'; i++) {
+        const char *option = tokens->data[i];
+        if (strcmp(option, "-q") == 0 && i + 1 < tokens->length) {
+            char *end;
+            long value = strtol(tokens->data[++i], &end, 10);
+            if (*end != '\0' || value < 1 || value > COPY_MAX_DEPTH) {
+                fprintf(stderr, "copy: Queue depth must be between 1 and %d\n", COPY_MAX_DEPTH);
+                return -1;
+            }
+            depth = value;
+        } else if (strcmp(option, "-c") == 0) {
+            concat = 1;
+        } else if (strcmp(option, "-p") == 0) {
+            use_threads = 1;
+        } else if (strcmp(option, "-s") == 0) {
+            silent = 1;
+        } else {
+            break;
+        }
+    }
+    if (tokens->length - i < 2) {
+        fprintf(stderr, "copy: Usage: copy [-q DEPTH] [-c] [-p] [-s] SRC... DEST\n");
+        return -1;
+    }
+
+    const char *dest = tokens->data[tokens->length - 1];
+    copy_job_t job;
+    memset(&job, 0, sizeof(job));
+    job.depth = depth;
+    job.dest = dest;
+    job.shared_fd = -1;
+    atomic_init(&job.next_file, 0);
+    atomic_init(&job.bytes, 0);
+    atomic_init(&job.failures, 0);
+
+    struct timespec start;
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    int status = plan_copy(&job, tokens->data + i, tokens->length - 1 - i, dest, concat);
+    if (status == 0 && concat) {
+        job.shared_fd = open(dest, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+        if (job.shared_fd == -1) {
+            fprintf(stderr, "copy: %s: %s\n", dest, strerror(errno));
+            status = -1;
+        }
+    }
+
+    const char *engine = "io_uring";
+    if (status == 0) {
+        if (use_threads || copy_with_uring(&job) == -1) {
+            engine = "threads";
+            status = copy_with_threads(&job);
+        }
+    }
+    if (job.shared_fd != -1 && close(job.shared_fd) == -1) {
+        fprintf(stderr, "copy: %s: %s\n", dest, strerror(errno));
+        status = -1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (status == 0 && !silent) {
+        double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        double mib = atomic_load(&job.bytes) / (1024.0 * 1024.0);
+        size_t copied = job.num_files - atomic_load(&job.failures);
+        printf("Copied %zu file%s, %.1f MiB in %.3f s (%.1f MiB/s, %s)\n", copied,
+               copied == 1 ? "" : "s", mib, seconds, seconds > 0 ? mib / seconds : 0.0, engine);
+    }
+
+    for (size_t f = 0; f < job.num_files; f++) {
+        free(job.files[f].dst);
+    }
+    free(job.files);
+    if (status == 0 && atomic_load(&job.failures) > 0) {
+        status = -1;
+    }
+    return status;
+}
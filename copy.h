@@ -0,0 +1,25 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef COPY_H
+#define COPY_H
+
+#include "string_vector.h"
+
+#define COPY_DEFAULT_DEPTH 32
+#define COPY_MAX_DEPTH 256
+
+/*
+ * The "copy" builtin: copy [-q DEPTH] [-c] [-p] [-s] SRC... DEST
+ * Copies each SRC to DEST, or into DEST if it is a directory. With -c, the
+ * SRC files are concatenated into DEST instead.
+ * Up to DEPTH files are copied at once. Opens, reads, writes, and closes are
+ * submitted in batches through io_uring; if io_uring is not available (or -p
+ * is given), a pool of DEPTH threads copies the files with copy_file_range().
+ * Unless -s is given, the number of files and bytes copied and the throughput
+ * are printed at the end.
+ * tokens: Tokens typed by the user, e.g., "copy -q 64 logs/a.txt logs/b.txt out/"
+ * Returns 0 if every file was copied or -1 on error
+ */
+int copy_command(const strvec_t *tokens);
+
+#endif    // COPY_H
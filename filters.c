@@ -0,0 +1,644 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#define _GNU_SOURCE
+
+#include "filters.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define FILTER_BUF_SIZE 65536
+#define DEFAULT_NUM_LINES 10
+
+typedef struct {
+    filter_stream_t *stream;
+    char buf[FILTER_BUF_SIZE];
+    size_t pos;
+    size_t len;
+    int eof;
+    char *line;    // Assembly buffer for lines that span reads
+    size_t line_cap;
+} filter_input_t;
+
+typedef struct {
+    filter_stream_t *stream;
+    char buf[FILTER_BUF_SIZE];
+    size_t len;
+    int failed;
+} filter_output_t;
+
+static ssize_t stream_read(filter_stream_t *s, void *buf, size_t len) {
+    if (s->ring != NULL) {
+        return ring_read(s->ring, buf, len);
+    }
+
+    ssize_t n;
+    do {
+        n = read(s->fd, buf, len);
+    } while (n == -1 && errno == EINTR);
+    return n;
+}
+
+static int stream_write(filter_stream_t *s, const char *buf, size_t len) {
+    if (s->ring != NULL) {
+        return ring_write(s->ring, buf, len);
+    }
+
+    while (len > 0) {
+        ssize_t n = write(s->fd, buf, len);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int input_fill(filter_input_t *in) {
+    if (in->eof) {
+        return 0;
+    }
+    ssize_t n = stream_read(in->stream, in->buf, sizeof(in->buf));
+    if (n <= 0) {
+        in->eof = 1;
+        return 0;
+    }
+    in->pos = 0;
+    in->len = n;
+    return 1;
+}
+
+// Get the next line (including its trailing '\n', if any) from the input.
+// The returned pointer is valid until the next call.
+// Returns the line's length or 0 at end of input
+static size_t input_getline(filter_input_t *in, char **line) {
+    if (in->pos == in->len && !input_fill(in)) {
+        return 0;
+    }
+
+    // Fast path: the whole line is already buffered
+    char *start = in->buf + in->pos;
+    char *nl = memchr(start, '\n', in->len - in->pos);
+    if (nl != NULL) {
+        size_t n = nl - start + 1;
+        in->pos += n;
+        *line = start;
+        return n;
+    }
+
+    // Slow path: copy pieces of the line until a newline or end of input
+    size_t n = 0;
+    while (1) {
+        size_t avail = in->len - in->pos;
+        nl = memchr(in->buf + in->pos, '\n', avail);
+        size_t chunk = nl != NULL ? (size_t) (nl - (in->buf + in->pos)) + 1 : avail;
+        if (n + chunk > in->line_cap) {
+            size_t cap = in->line_cap == 0 ? 256 : in->line_cap;
+            while (cap < n + chunk) {
+                cap *= 2;
+            }
+            char *grown = realloc(in->line, cap);
+            if (grown == NULL) {
+                break;
+            }
+            in->line = grown;
+            in->line_cap = cap;
+        }
+        memcpy(in->line + n, in->buf + in->pos, chunk);
+        n += chunk;
+        in->pos += chunk;
+        if (nl != NULL || !input_fill(in)) {
+            break;
+        }
+    }
+    *line = in->line;
+    return n;
+}
+
+static void output_flush(filter_output_t *out) {
+    if (out->len > 0 && !out->failed) {
+        if (stream_write(out->stream, out->buf, out->len) == -1) {
+            out->failed = 1;
+        }
+    }
+    out->len = 0;
+}
+
+static void output_write(filter_output_t *out, const char *buf, size_t len) {
+    if (out->failed) {
+        return;
+    }
+    if (out->len + len > sizeof(out->buf)) {
+        output_flush(out);
+        if (len > sizeof(out->buf)) {
+            if (stream_write(out->stream, buf, len) == -1) {
+                out->failed = 1;
+            }
+            return;
+        }
+    }
+    memcpy(out->buf + out->len, buf, len);
+    out->len += len;
+}
+
+// Write a line, adding the trailing newline if the input's last line lacked one
+static void output_line(filter_output_t *out, const char *line, size_t len) {
+    output_write(out, line, len);
+    if (len == 0 || line[len - 1] != '\n') {
+        output_write(out, "\n", 1);
+    }
+}
+
+static int parse_count(const char *s, long *count) {
+    char *end;
+    errno = 0;
+    long n = strtol(s, &end, 10);
+    if (errno != 0 || *s == '\0' || *end != '\0' || n < 0) {
+        return -1;
+    }
+    *count = n;
+    return 0;
+}
+
+// Parse a cut(1) list such as "1,3-5,7-"
+static int parse_ranges(const char *s, filter_t *filter) {
+    filter->num_ranges = 0;
+    while (*s != '\0') {
+        if (filter->num_ranges == MAX_CUT_RANGES) {
+            return -1;
+        }
+        cut_range_t *range = &filter->ranges[filter->num_ranges++];
+        char *end;
+        int has_lo = 0;
+        range->lo = 1;
+        range->hi = 0;    // 0 means "to end of line"
+        if (isdigit((unsigned char) *s)) {
+            range->lo = range->hi = strtol(s, &end, 10);
+            if (range->lo < 1) {
+                return -1;
+            }
+            s = end;
+            has_lo = 1;
+        }
+        if (*s == '-') {
+            s++;
+            if (isdigit((unsigned char) *s)) {
+                range->hi = strtol(s, &end, 10);
+                if (range->hi < range->lo) {
+                    return -1;
+                }
+                s = end;
+            } else if (!has_lo) {
+                return -1;
+            } else {
+                range->hi = 0;
+            }
+        } else if (!has_lo) {
+            return -1;
+        }
+        if (*s == ',') {
+            s++;
+        } else if (*s != '\0') {
+            return -1;
+        }
+    }
+    return filter->num_ranges > 0 ? 0 : -1;
+}
+
+static int cut_selected(const filter_t *filter, long pos) {
+    for (int i = 0; i < filter->num_ranges; i++) {
+        const cut_range_t *range = &filter->ranges[i];
+        if (pos >= range->lo && (range->hi == 0 || pos <= range->hi)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Options of the form "-n N", "-nN" or "-N" for head and tail
+static int parse_line_count(const strvec_t *tokens, filter_t *filter) {
+    filter->num_lines = DEFAULT_NUM_LINES;
+    filter->from_start = 0;
+    for (int i = 1; i < tokens->length; i++) {
+        const char *arg = tokens->data[i];
+        const char *value;
+        if (strcmp(arg, "-n") == 0) {
+            if (++i == tokens->length) {
+                return -1;
+            }
+            value = tokens->data[i];
+        } else if (strncmp(arg, "-n", 2) == 0) {
+            value = arg + 2;
+        } else if (arg[0] == '-' && isdigit((unsigned char) arg[1])) {
+            value = arg + 1;
+        } else {
+            return -1;    // File operands and other options go to the real program
+        }
+
+        if (filter->kind == FILTER_TAIL && value[0] == '+') {
+            filter->from_start = 1;
+            value++;
+        }
+        if (parse_count(value, &filter->num_lines) == -1) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int prepare_grep(const strvec_t *tokens, filter_t *filter) {
+    int fixed = 0;
+    filter->pattern = NULL;
+    for (int i = 1; i < tokens->length; i++) {
+        const char *arg = tokens->data[i];
+        if (arg[0] == '-' && arg[1] != '\0') {
+            for (const char *c = arg + 1; *c != '\0'; c++) {
+                if (*c == 'F') {
+                    fixed = 1;
+                } else if (*c == 'v') {
+                    filter->invert = 1;
+                } else if (*c == 'i') {
+                    filter->ignore_case = 1;
+                } else if (*c == 'c') {
+                    filter->count_only = 1;
+                } else {
+                    return -1;
+                }
+            }
+        } else if (filter->pattern == NULL) {
+            filter->pattern = arg;
+        } else {
+            return -1;    // File operand
+        }
+    }
+
+    if (filter->pattern == NULL || filter->pattern[0] == '\0') {
+        return -1;
+    }
+    // Without -F, only patterns with no regex metacharacters match literally
+    if (!fixed && strpbrk(filter->pattern, ".[]*^$\\") != NULL) {
+        return -1;
+    }
+    return 0;
+}
+
+static int prepare_wc(const strvec_t *tokens, filter_t *filter) {
+    for (int i = 1; i < tokens->length; i++) {
+        const char *arg = tokens->data[i];
+        if (arg[0] != '-' || arg[1] == '\0') {
+            return -1;
+        }
+        for (const char *c = arg + 1; *c != '\0'; c++) {
+            if (*c == 'l') {
+                filter->count_lines = 1;
+            } else if (*c == 'w') {
+                filter->count_words = 1;
+            } else if (*c == 'c') {
+                filter->count_bytes = 1;
+            } else {
+                return -1;
+            }
+        }
+    }
+
+    if (!filter->count_lines && !filter->count_words && !filter->count_bytes) {
+        filter->count_lines = filter->count_words = filter->count_bytes = 1;
+    }
+    return 0;
+}
+
+static int prepare_cut(const strvec_t *tokens, filter_t *filter) {
+    int have_list = 0;
+    int have_delim = 0;
+    filter->delim = '\t';
+    for (int i = 1; i < tokens->length; i++) {
+        const char *arg = tokens->data[i];
+        if (arg[0] != '-' || arg[1] == '\0') {
+            return -1;
+        }
+        char opt = arg[1];
+        if (opt == 's' && arg[2] == '\0') {
+            filter->only_delimited = 1;
+            continue;
+        }
+        if (opt != 'd' && opt != 'f' && opt != 'c' && opt != 'b') {
+            return -1;
+        }
+        const char *value = arg + 2;
+        if (*value == '\0') {
+            if (++i == tokens->length) {
+                return -1;
+            }
+            value = tokens->data[i];
+        }
+
+        if (opt == 'd') {
+            if (strlen(value) != 1) {
+                return -1;
+            }
+            filter->delim = value[0];
+            have_delim = 1;
+        } else {
+            if (have_list || parse_ranges(value, filter) == -1) {
+                return -1;
+            }
+            filter->by_field = opt == 'f';
+            have_list = 1;
+        }
+    }
+
+    if (!have_list || (!filter->by_field && (have_delim || filter->only_delimited))) {
+        return -1;
+    }
+    return 0;
+}
+
+int filter_prepare(const strvec_t *tokens, filter_t *filter) {
+    if (tokens->length == 0) {
+        return -1;
+    }
+    memset(filter, 0, sizeof(*filter));
+
+    const char *name = tokens->data[0];
+    if (strcmp(name, "grep") == 0) {
+        filter->kind = FILTER_GREP;
+        return prepare_grep(tokens, filter);
+    } else if (strcmp(name, "wc") == 0) {
+        filter->kind = FILTER_WC;
+        return prepare_wc(tokens, filter);
+    } else if (strcmp(name, "head") == 0) {
+        filter->kind = FILTER_HEAD;
+        return parse_line_count(tokens, filter);
+    } else if (strcmp(name, "tail") == 0) {
+        filter->kind = FILTER_TAIL;
+        return parse_line_count(tokens, filter);
+    } else if (strcmp(name, "cut") == 0) {
+        filter->kind = FILTER_CUT;
+        return prepare_cut(tokens, filter);
+    }
+    return -1;
+}
+
+static int line_matches(const filter_t *filter, const char *line, size_t len, size_t pat_len) {
+    if (!filter->ignore_case) {
+        return memmem(line, len, filter->pattern, pat_len) != NULL;
+    }
+    for (size_t i = 0; i + pat_len <= len; i++) {
+        if (strncasecmp(line + i, filter->pattern, pat_len) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int run_grep(const filter_t *filter, filter_input_t *in, filter_output_t *out) {
+    size_t pat_len = strlen(filter->pattern);
+    long count = 0;
+    char *line;
+    size_t len;
+    while ((len = input_getline(in, &line)) > 0 && !out->failed) {
+        size_t text_len = line[len - 1] == '\n' ? len - 1 : len;
+        if (line_matches(filter, line, text_len, pat_len) != filter->invert) {
+            count++;
+            if (!filter->count_only) {
+                output_line(out, line, len);
+            }
+        }
+    }
+
+    if (filter->count_only) {
+        char num[32];
+        int n = snprintf(num, sizeof(num), "%ld\n", count);
+        output_write(out, num, n);
+    }
+    return count > 0 ? 0 : 1;
+}
+
+static int run_wc(const filter_t *filter, filter_input_t *in, filter_output_t *out) {
+    long lines = 0;
+    long words = 0;
+    long bytes = 0;
+    int in_word = 0;
+    while (in->pos < in->len || input_fill(in)) {
+        const char *p = in->buf + in->pos;
+        size_t n = in->len - in->pos;
+        bytes += n;
+        for (size_t i = 0; i < n; i++) {
+            if (p[i] == '\n') {
+                lines++;
+            }
+            if (isspace((unsigned char) p[i])) {
+                in_word = 0;
+            } else if (!in_word) {
+                in_word = 1;
+                words++;
+            }
+        }
+        in->pos = in->len;
+    }
+
+    // Match GNU wc's formatting for standard input: a bare number for a
+    // single count, otherwise columns 7 wide
+    long counts[3];
+    int num_counts = 0;
+    if (filter->count_lines) {
+        counts[num_counts++] = lines;
+    }
+    if (filter->count_words) {
+        counts[num_counts++] = words;
+    }
+    if (filter->count_bytes) {
+        counts[num_counts++] = bytes;
+    }
+
+    char result[128];
+    int len = 0;
+    for (int i = 0; i < num_counts; i++) {
+        if (num_counts == 1) {
+            len += snprintf(result + len, sizeof(result) - len, "%ld", counts[i]);
+        } else {
+            len += snprintf(result + len, sizeof(result) - len, "%s%7ld", i > 0 ? " " : "",
+                            counts[i]);
+        }
+    }
+    result[len++] = '\n';
+    output_write(out, result, len);
+    return 0;
+}
+
+static int run_head(const filter_t *filter, filter_input_t *in, filter_output_t *out) {
+    char *line;
+    size_t len;
+    for (long i = 0; i < filter->num_lines && !out->failed; i++) {
+        if ((len = input_getline(in, &line)) == 0) {
+            break;
+        }
+        output_write(out, line, len);
+    }
+    return 0;
+}
+
+static int run_tail(const filter_t *filter, filter_input_t *in, filter_output_t *out) {
+    char *line;
+    size_t len;
+    if (filter->from_start) {
+        long skip = filter->num_lines > 0 ? filter->num_lines - 1 : 0;
+        while ((len = input_getline(in, &line)) > 0 && !out->failed) {
+            if (skip > 0) {
+                skip--;
+            } else {
+                output_write(out, line, len);
+            }
+        }
+        return 0;
+    }
+
+    if (filter->num_lines == 0) {
+        while (input_getline(in, &line) > 0) {
+        }
+        return 0;
+    }
+
+    // Keep the last N lines in a circular array of reusable buffers
+    typedef struct {
+        char *data;
+        size_t len;
+        size_t cap;
+    } saved_line_t;
+    saved_line_t *saved = calloc(filter->num_lines, sizeof(saved_line_t));
+    if (saved == NULL) {
+        perror("tail: calloc");
+        return 1;
+    }
+
+    long total = 0;
+    int status = 0;
+    while ((len = input_getline(in, &line)) > 0) {
+        saved_line_t *slot = &saved[total % filter->num_lines];
+        if (len > slot->cap) {
+            char *grown = realloc(slot->data, len);
+            if (grown == NULL) {
+                perror("tail: realloc");
+                status = 1;
+                break;
+            }
+            slot->data = grown;
+            slot->cap = len;
+        }
+        memcpy(slot->data, line, len);
+        slot->len = len;
+        total++;
+    }
+
+    long start = total > filter->num_lines ? total - filter->num_lines : 0;
+    for (long i = start; i < total; i++) {
+        saved_line_t *slot = &saved[i % filter->num_lines];
+        output_write(out, slot->data, slot->len);
+    }
+    for (long i = 0; i < filter->num_lines; i++) {
+        free(saved[i].data);
+    }
+    free(saved);
+    return status;
+}
+
+static int run_cut(const filter_t *filter, filter_input_t *in, filter_output_t *out) {
+    char *line;
+    size_t len;
+    while ((len = input_getline(in, &line)) > 0 && !out->failed) {
+        size_t text_len = line[len - 1] == '\n' ? len - 1 : len;
+
+        if (!filter->by_field) {
+            for (size_t i = 0; i < text_len; i++) {
+                if (cut_selected(filter, i + 1)) {
+                    output_write(out, line + i, 1);
+                }
+            }
+            output_write(out, "\n", 1);
+            continue;
+        }
+
+        if (memchr(line, filter->delim, text_len) == NULL) {
+            if (!filter->only_delimited) {
+                output_line(out, line, len);
+            }
+            continue;
+        }
+
+        long field = 1;
+        int first = 1;
+        size_t start = 0;
+        for (size_t i = 0; i <= text_len; i++) {
+            if (i == text_len || line[i] == filter->delim) {
+                if (cut_selected(filter, field)) {
+                    if (!first) {
+                        output_write(out, &filter->delim, 1);
+                    }
+                    output_write(out, line + start, i - start);
+                    first = 0;
+                }
+                field++;
+                start = i + 1;
+            }
+        }
+        output_write(out, "\n", 1);
+    }
+    return 0;
+}
+
+int filter_run(const filter_t *filter, filter_stream_t *in_stream, filter_stream_t *out_stream) {
+    filter_input_t *in = malloc(sizeof(filter_input_t));
+    filter_output_t *out = malloc(sizeof(filter_output_t));
+    if (in == NULL || out == NULL) {
+        perror("filter: malloc");
+        free(in);
+        free(out);
+        return 1;
+    }
+    in->stream = in_stream;
+    in->pos = in->len = 0;
+    in->eof = 0;
+    in->line = NULL;
+    in->line_cap = 0;
+    out->stream = out_stream;
+    out->len = 0;
+    out->failed = 0;
+
+    int status = 0;
+    switch (filter->kind) {
+        case FILTER_GREP:
+            status = run_grep(filter, in, out);
+            break;
+        case FILTER_WC:
+            status = run_wc(filter, in, out);
+            break;
+        case FILTER_HEAD:
+            status = run_head(filter, in, out);
+            break;
+        case FILTER_TAIL:
+            status = run_tail(filter, in, out);
+            break;
+        case FILTER_CUT:
+            status = run_cut(filter, in, out);
+            break;
+    }
+    output_flush(out);
+
+    // A real process would have been killed by SIGPIPE here
+    if (out->failed) {
+        status = 128 + SIGPIPE;
+    }
+    free(in->line);
+    free(in);
+    free(out);
+    return status;
+}
@@ -0,0 +1,81 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef FILTERS_H
+#define FILTERS_H
+
+#include "ring_buffer.h"
+#include "string_vector.h"
+
+#define MAX_CUT_RANGES 16
+
+typedef enum {
+    FILTER_GREP,
+    FILTER_WC,
+    FILTER_HEAD,
+    FILTER_TAIL,
+    FILTER_CUT,
+} filter_kind_t;
+
+/*
+ * One end of a filter stage: either a file descriptor (when connected to an
+ * external process, a file, or the terminal) or an in-memory ring buffer
+ * (when connected to another builtin filter stage).
+ */
+typedef struct {
+    int fd;    // Only used when 'ring' is NULL
+    ring_buffer_t *ring;
+} filter_stream_t;
+
+typedef struct {
+    long lo;
+    long hi;
+} cut_range_t;
+
+typedef struct {
+    filter_kind_t kind;
+
+    // grep: fixed-string matching only
+    const char *pattern;
+    int invert;
+    int ignore_case;
+    int count_only;
+
+    // wc
+    int count_lines;
+    int count_words;
+    int count_bytes;
+
+    // head and tail
+    long num_lines;
+    int from_start;    // tail -n +N
+
+    // cut
+    char delim;
+    int by_field;
+    int only_delimited;
+    cut_range_t ranges[MAX_CUT_RANGES];
+    int num_ranges;
+} filter_t;
+
+/*
+ * Check whether a pipeline stage can be run as an in-process builtin filter
+ * and, if so, parse its options. Stages that use options or operands the
+ * builtin versions do not support (e.g., file arguments or regular
+ * expressions) are rejected so that they run as external programs instead.
+ * tokens: Tokens of a single pipeline stage, e.g., "head -n 5"
+ * filter: Filled in with the parsed stage on success
+ * Returns 0 if the stage can run as a builtin filter or -1 otherwise
+ */
+int filter_prepare(const strvec_t *tokens, filter_t *filter);
+
+/*
+ * Run a builtin filter to completion, reading from 'in' and writing to 'out'.
+ * Neither stream is closed by this function.
+ * filter: A filter initialized by filter_prepare()
+ * in: Stream to read input from
+ * out: Stream to write output to
+ * Returns the filter's exit status (0 on success, as for the real program)
+ */
+int filter_run(const filter_t *filter, filter_stream_t *in, filter_stream_t *out);
+
+#endif    // FILTERS_H
@@ -0,0 +1,569 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#define _GNU_SOURCE
+
+#include "history.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "variables.h"
+
+#define INDEX_INITIAL_BITS 12
+#define COPY_BUF_SIZE 16384
+
+typedef struct {
+    const char *text;    // Not terminated; points into the mapped file or a copy of the line
+    unsigned len;
+} entry_t;
+
+// The ids of the entries containing one trigram, stored as varint-encoded gaps between
+// ascending ids
+typedef struct {
+    uint32_t key;    // The trigram's three bytes plus one, so that 0 marks an unused slot
+    uint32_t count;
+    uint32_t last_id;
+    uint32_t len;
+    uint32_t cap;
+    uint8_t *data;
+} posting_list_t;
+
+static struct {
+    char *path;    // NULL if history is not saved to a file
+    // The history file as it was at startup. Other shells only ever append to it or
+    // replace it with rename(), so the mapping stays valid.
+    char *map;
+    size_t map_len;
+    int loaded;    // Whether the entries in 'map' have been located yet
+    entry_t *entries;    // Entries from the file, then those added in this session
+    unsigned length;
+    unsigned capacity;
+    unsigned num_mapped;
+    posting_list_t *index;    // Open-addressing hash table of trigrams
+    unsigned index_bits;
+    unsigned index_used;
+    unsigned num_indexed;    // Entries added to the index so far
+} history;
+
+static int write_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// Copy everything in 'fd' from 'offset' onward to 'out'
+static int copy_tail(int fd, off_t offset, int out) {
+    char buf[COPY_BUF_SIZE];
+    while (1) {
+        ssize_t n = pread(fd, buf, sizeof(buf), offset);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        } else if (n <= 0) {
+            return n;
+        } else if (write_all(out, buf, n) == -1) {
+            return -1;
+        }
+        offset += n;
+    }
+}
+
+// Replace the history file with one holding only its newest 'keep' bytes, cut at an entry
+// boundary. The new file is written beside the old one and renamed over it, so mappings of
+// the old file held by other shells stay valid.
+// Returns 0 on success or -1 on error
+static int shrink_file(const char *path, size_t keep) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        if (errno == ENOENT) {
+            return 0;
+        }
+        perror("Failed to open history file");
+        return -1;
+    }
+    // Only one shell rewrites the file at a time
+    if (flock(fd, LOCK_EX) == -1) {
+        perror("flock");
+        close(fd);
+        return -1;
+    }
+
+    // Another shell may have already replaced the file while we waited for the lock
+    struct stat st;
+    struct stat path_st;
+    if (fstat(fd, &st) == -1 || stat(path, &path_st) == -1 || st.st_ino != path_st.st_ino ||
+        st.st_dev != path_st.st_dev || st.st_size <= keep) {
+        close(fd);
+        return 0;
+    }
+
+    size_t size = st.st_size;
+    size_t start = size;
+    char *map = NULL;
+    if (keep > 0) {
+        map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            perror("mmap");
+            close(fd);
+            return -1;
+        }
+        char *newline = memchr(map + size - keep - 1, '\n', keep + 1);
+        start = newline != NULL ? newline - map + 1 : size;
+    }
+
+    int status = -1;
+    char *tmp_path = NULL;
+    if (asprintf(&tmp_path, "%s.tmp.%d", path, getpid()) == -1) {
+        perror("asprintf");
+        tmp_path = NULL;
+    } else {
+        int out = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+        if (out == -1) {
+            perror("Failed to create history file");
+        } else {
+            // Keep entries that other shells appended after we measured the file
+            if ((start == size || write_all(out, map + start, size - start) == 0) &&
+                copy_tail(fd, size, out) == 0) {
+                status = 0;
+            }
+            if (close(out) == -1) {
+                status = -1;
+            }
+            if (status == -1) {
+                perror("Failed to write history file");
+            } else if (rename(tmp_path, path) == -1) {
+                perror("rename");
+                status = -1;
+            }
+            if (status == -1) {
+                unlink(tmp_path);
+            }
+        }
+    }
+
+    free(tmp_path);
+    if (map != NULL) {
+        munmap(map, size);
+    }
+    close(fd);
+    return status;
+}
+
+static void stop_saving(void) {
+    free(history.path);
+    history.path = NULL;
+}
+
+int history_init(void) {
+    const char *path = vars_get("SWISH_HISTFILE");
+    if (path == NULL) {
+        const char *home = vars_get("HOME");
+        if (home == NULL) {
+            return 0;
+        }
+        if (asprintf(&history.path, "%s/%s", home, HISTORY_FILE_NAME) == -1) {
+            perror("asprintf");
+            history.path = NULL;
+            return -1;
+        }
+    } else if (path[0] == '\0') {
+        return 0;
+    } else if ((history.path = strdup(path)) == NULL) {
+        perror("strdup");
+        return -1;
+    }
+
+    struct stat st;
+    if (stat(history.path, &st) == 0 && st.st_size > HISTORY_MAX_BYTES) {
+        shrink_file(history.path, HISTORY_KEEP_BYTES);
+    }
+
+    int fd = open(history.path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        if (errno == ENOENT) {
+            return 0;
+        }
+        perror("Failed to open history file");
+        stop_saving();
+        return -1;
+    }
+    if (fstat(fd, &st) == -1) {
+        perror("fstat");
+        close(fd);
+        stop_saving();
+        return -1;
+    }
+    if (st.st_size > 0) {
+        history.map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (history.map == MAP_FAILED) {
+            perror("mmap");
+            history.map = NULL;
+            close(fd);
+            stop_saving();
+            return -1;
+        }
+        history.map_len = st.st_size;
+    }
+    close(fd);
+    return 0;
+}
+
+static void index_free(void) {
+    if (history.index != NULL) {
+        for (unsigned i = 0; i < (1u << history.index_bits); i++) {
+            free(history.index[i].data);
+        }
+    }
+    free(history.index);
+    history.index = NULL;
+    history.index_bits = 0;
+    history.index_used = 0;
+    history.num_indexed = 0;
+}
+
+static void clear_entries(void) {
+    for (unsigned i = history.num_mapped; i < history.length; i++) {
+        free((char *) history.entries[i].text);
+    }
+    free(history.entries);
+    history.entries = NULL;
+    history.length = 0;
+    history.capacity = 0;
+    history.num_mapped = 0;
+    if (history.map != NULL) {
+        munmap(history.map, history.map_len);
+    }
+    history.map = NULL;
+    history.map_len = 0;
+    index_free();
+}
+
+void history_free(void) {
+    clear_entries();
+    history.loaded = 0;
+    stop_saving();
+}
+
+static int reserve_entries(unsigned count) {
+    if (history.length + count <= history.capacity) {
+        return 0;
+    }
+    unsigned capacity = history.capacity == 0 ? 64 : history.capacity;
+    while (capacity < history.length + count) {
+        capacity *= 2;
+    }
+    entry_t *entries = realloc(history.entries, capacity * sizeof(entry_t));
+    if (entries == NULL) {
+        perror("realloc");
+        return -1;
+    }
+    history.entries = entries;
+    history.capacity = capacity;
+    return 0;
+}
+
+// Locate the entries of the mapped file, placing them ahead of those added this session
+static int load_mapped(void) {
+    if (history.loaded) {
+        return 0;
+    }
+    const char *end = history.map + history.map_len;
+    unsigned count = 0;
+    const char *newline;
+    for (const char *p = history.map; p < end && (newline = memchr(p, '\n', end - p)) != NULL;
+         p = newline + 1) {
+        count += newline > p;
+    }
+    if (reserve_entries(count) == -1) {
+        return -1;
+    }
+
+    memmove(history.entries + count, history.entries, history.length * sizeof(entry_t));
+    entry_t *entry = history.entries;
+    for (const char *p = history.map; entry < history.entries + count; p = newline + 1) {
+        newline = memchr(p, '\n', end - p);
+        if (newline > p) {
+            entry->text = p;
+            entry->len = newline - p;
+            entry++;
+        }
+    }
+    history.num_mapped = count;
+    history.length += count;
+    history.loaded = 1;
+    return 0;
+}
+
+// Find the most recent entry without locating every entry of the mapped file
+static int last_entry(const char **text, unsigned *len) {
+    if (history.length > 0) {
+        *text = history.entries[history.length - 1].text;
+        *len = history.entries[history.length - 1].len;
+        return 1;
+    }
+    const char *end = history.map + history.map_len;
+    while (end > history.map && end[-1] == '\n') {
+        end--;
+    }
+    if (end == history.map) {
+        return 0;
+    }
+    const char *newline = memrchr(history.map, '\n', end - history.map);
+    *text = newline != NULL ? newline + 1 : history.map;
+    *len = end - *text;
+    return 1;
+}
+
+void history_add(const char *line) {
+    size_t len = strlen(line);
+    if (line[strspn(line, " \t")] == '\0') {
+        return;
+    }
+    const char *last;
+    unsigned last_len;
+    if (last_entry(&last, &last_len) && last_len == len && memcmp(last, line, len) == 0) {
+        return;
+    }
+
+    if (reserve_entries(1) == 0) {
+        char *copy = strdup(line);
+        if (copy != NULL) {
+            history.entries[history.length].text = copy;
+            history.entries[history.length].len = len;
+            history.length++;
+        }
+    }
+
+    if (history.path == NULL) {
+        return;
+    }
+    // The file is reopened for each entry so that we follow it when another shell
+    // replaces it during compaction
+    int fd = open(history.path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+    if (fd == -1) {
+        perror("Failed to open history file");
+        stop_saving();
+        return;
+    }
+    struct iovec iov[2] = {{(char *) line, len}, {"\n", 1}};
+    ssize_t written = writev(fd, iov, 2);
+    struct stat st;
+    int too_big = fstat(fd, &st) == 0 && st.st_size > HISTORY_MAX_BYTES;
+    close(fd);
+    if (written != (ssize_t) len + 1) {
+        perror("Failed to write history file");
+        stop_saving();
+    } else if (too_big) {
+        shrink_file(history.path, HISTORY_KEEP_BYTES);
+    }
+}
+
+unsigned history_length(void) {
+    if (load_mapped() == -1) {
+        return 0;
+    }
+    return history.length;
+}
+
+const char *history_get(unsigned id, unsigned *len) {
+    *len = history.entries[id].len;
+    return history.entries[id].text;
+}
+
+static unsigned trigram_slot(uint32_t key) {
+    return (key * 2654435761u) >> (32 - history.index_bits);
+}
+
+static int index_grow(void) {
+    unsigned bits = history.index == NULL ? INDEX_INITIAL_BITS : history.index_bits + 1;
+    posting_list_t *table = calloc(1u << bits, sizeof(posting_list_t));
+    if (table == NULL) {
+        perror("calloc");
+        return -1;
+    }
+    posting_list_t *old = history.index;
+    unsigned old_size = old == NULL ? 0 : 1u << history.index_bits;
+    history.index = table;
+    history.index_bits = bits;
+    unsigned mask = (1u << bits) - 1;
+    for (unsigned i = 0; i < old_size; i++) {
+        if (old[i].key != 0) {
+            unsigned slot = trigram_slot(old[i].key);
+            while (table[slot].key != 0) {
+                slot = (slot + 1) & mask;
+            }
+            table[slot] = old[i];
+        }
+    }
+    free(old);
+    return 0;
+}
+
+static posting_list_t *index_lookup(uint32_t key) {
+    unsigned mask = (1u << history.index_bits) - 1;
+    for (unsigned slot = trigram_slot(key);; slot = (slot + 1) & mask) {
+        if (history.index[slot].key == key || history.index[slot].key == 0) {
+            return &history.index[slot];
+        }
+    }
+}
+
+static uint32_t trigram_key(const char *s) {
+    return ((uint32_t) (unsigned char) s[0] << 16 | (uint32_t) (unsigned char) s[1] << 8 |
+            (unsigned char) s[2]) + 1;
+}
+
+static int posting_add(posting_list_t *list, uint32_t id) {
+    if (list->count > 0 && list->last_id == id) {
+        return 0;
+    }
+    if (list->len + 5 > list->cap) {
+        uint32_t cap = list->cap == 0 ? 8 : list->cap * 2;
+        uint8_t *data = realloc(list->data, cap);
+        if (data == NULL) {
+            perror("realloc");
+            return -1;
+        }
+        list->data = data;
+        list->cap = cap;
+    }
+    uint32_t gap = list->count == 0 ? id : id - list->last_id;
+    do {
+        list->data[list->len++] = (gap & 0x7f) | (gap >= 0x80 ? 0x80 : 0);
+        gap >>= 7;
+    } while (gap != 0);
+    list->count++;
+    list->last_id = id;
+    return 0;
+}
+
+// Add any entries not yet in the trigram index
+static int index_update(void) {
+    while (history.num_indexed < history.length) {
+        entry_t *entry = &history.entries[history.num_indexed];
+        for (unsigned i = 0; i + 3 <= entry->len; i++) {
+            if ((history.index_used + 1) * 4 > (3u << history.index_bits) &&
+                index_grow() == -1) {
+                return -1;
+            }
+            uint32_t key = trigram_key(entry->text + i);
+            posting_list_t *list = index_lookup(key);
+            if (list->key == 0) {
+                list->key = key;
+                history.index_used++;
+            }
+            if (posting_add(list, history.num_indexed) == -1) {
+                return -1;
+            }
+        }
+        history.num_indexed++;
+    }
+    return 0;
+}
+
+static void print_entry(unsigned id) {
+    printf("%5u  %.*s\n", id + 1, history.entries[id].len, history.entries[id].text);
+}
+
+static int entry_matches(unsigned id, const char *pattern, size_t len) {
+    return memmem(history.entries[id].text, history.entries[id].len, pattern, len) != NULL;
+}
+
+// Print the entries containing 'pattern'. Candidates come from the posting list of the
+// pattern's rarest trigram; each is then checked in full.
+static void search(const char *pattern, size_t len) {
+    if (len >= 3 && (history.index != NULL || index_grow() == 0) && index_update() == 0) {
+        posting_list_t *rarest = NULL;
+        for (size_t i = 0; i + 3 <= len; i++) {
+            posting_list_t *list = index_lookup(trigram_key(pattern + i));
+            if (list->key == 0) {
+                return;
+            }
+            if (rarest == NULL || list->count < rarest->count) {
+                rarest = list;
+            }
+        }
+
+        uint32_t id = 0;
+        for (uint32_t pos = 0; pos < rarest->len;) {
+            uint32_t gap = 0;
+            for (unsigned shift = 0;; shift += 7) {
+                uint8_t byte = rarest->data[pos++];
+                gap |= (uint32_t) (byte & 0x7f) << shift;
+                if (!(byte & 0x80)) {
+                    break;
+                }
+            }
+            id += gap;
+            if (entry_matches(id, pattern, len)) {
+                print_entry(id);
+            }
+        }
+        return;
+    }
+
+    // Patterns too short to have a trigram, or an index we could not build, need a full scan
+    index_free();
+    for (unsigned id = 0; id < history.length; id++) {
+        if (entry_matches(id, pattern, len)) {
+            print_entry(id);
+        }
+    }
+}
+
+int history_command(const strvec_t *tokens) {
+    if (tokens->length == 2 && strcmp(tokens->data[1], "-c") == 0) {
+        clear_entries();
+        history.loaded = 1;
+        if (history.path != NULL && shrink_file(history.path, 0) == -1) {
+            return -1;
+        }
+        return 0;
+    }
+
+    if (load_mapped() == -1) {
+        return -1;
+    }
+    if (tokens->length == 1) {
+        for (unsigned id = 0; id < history.length; id++) {
+            print_entry(id);
+        }
+        return 0;
+    }
+
+    size_t len = 0;
+    for (unsigned i = 1; i < tokens->length; i++) {
+        len += strlen(tokens->data[i]) + 1;
+    }
+    char *pattern = malloc(len);
+    if (pattern == NULL) {
+        perror("malloc");
+        return -1;
+    }
+    char *end = pattern;
+    for (unsigned i = 1; i < tokens->length; i++) {
+        end = stpcpy(end, tokens->data[i]);
+        *end++ = ' ';
+    }
+    end[-1] = '\0';
+    search(pattern, len - 1);
+    free(pattern);
+    return 0;
+}
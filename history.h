@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "string_vector.h"
+
+#define HISTORY_FILE_NAME ".swish_history"
+
+// Once the history file grows past HISTORY_MAX_BYTES, it is rewritten to hold
+// only its newest HISTORY_KEEP_BYTES
+#define HISTORY_MAX_BYTES (32 << 20)
+#define HISTORY_KEEP_BYTES (16 << 20)
+
+/*
+ * Open the history file: $SWISH_HISTFILE, or ~/.swish_history if that is not
+ * set. History is disabled if SWISH_HISTFILE is set but empty. The file is
+ * compacted if it has grown too large, then memory-mapped; its entries are
+ * only located when history is first used.
+ * Returns 0 on success or -1 on error, in which case history is disabled
+ */
+int history_init(void);
+
+/*
+ * Unmap the history file and free all history entries
+ */
+void history_free(void);
+
+/*
+ * Add a command line to the history. It is appended to the history file as one
+ * O_APPEND write, so shells sharing the file never interleave their entries.
+ * Blank lines and repeats of the previous entry are not recorded.
+ * line: The command line, without its trailing newline
+ */
+void history_add(const char *line);
+
+/*
+ * Get the number of history entries
+ * Returns the number of entries, or 0 if they could not be loaded
+ */
+unsigned history_length(void);
+
+/*
+ * Get a history entry. Entries are not null-terminated.
+ * id: The entry's number, counting from 0 for the oldest
+ * len: Set to the length of the entry
+ * Returns the start of the entry's text
+ */
+const char *history_get(unsigned id, unsigned *len);
+
+/*
+ * The "history" builtin: history [-c | PATTERN...]
+ * Prints every history entry with its number, or only those containing
+ * PATTERN (the words joined by single spaces). Searches go through a trigram
+ * index built on first use. With -c, the history file is emptied.
+ * tokens: Tokens typed by the user, e.g., "history git commit"
+ * Returns 0 on success or -1 on error
+ */
+int history_command(const strvec_t *tokens);
+
+#endif    // HISTORY_H
@@ -6,6 +6,15 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
+#include <time.h>
+
+#include "allocator.h"
+
+static uint64_t now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000u + now.tv_nsec;
+}
 
 void job_list_init(job_list_t *list) {
     list->head = NULL;
@@ -17,7 +26,7 @@ void job_list_free(job_list_t *list) {
     while (current != NULL) {
         job_t *temp = current;
         current = current->next;
-        free(temp);
+        mem_free(MEM_JOBS, temp, sizeof(job_t));
     }
     list->head = NULL;
     list->length = 0;
@@ -25,7 +34,7 @@ void job_list_free(job_list_t *list) {
 
 int job_list_add(job_list_t *list, pid_t pid, const char *name, job_status_t status) {
     if (list->head == NULL) {
-        if ((list->head = malloc(sizeof(job_t))) == NULL) {
+        if ((list->head = mem_alloc(MEM_JOBS, sizeof(job_t))) == NULL) {
             return -1;
         }
         strncpy(list->head->name, name, NAME_LEN);
@@ -33,6 +42,7 @@ int job_list_add(job_list_t *list, pid_t pid, const char *name, job_status_t sta
         list->head->status = status;
         list->head->next = NULL;
         list->head->pid = pid;
+        list->head->start_ns = now_ns();
         list->length = 1;
         return 0;
     }
@@ -41,7 +51,7 @@ int job_list_add(job_list_t *list, pid_t pid, const char *name, job_status_t sta
     while (current->next != NULL) {
         current = current->next;
     }
-    if ((current->next = malloc(sizeof(job_t))) == NULL) {
+    if ((current->next = mem_alloc(MEM_JOBS, sizeof(job_t))) == NULL) {
         return -1;
     }
     strncpy(current->next->name, name, NAME_LEN);
@@ -49,6 +59,7 @@ int job_list_add(job_list_t *list, pid_t pid, const char *name, job_status_t sta
     current->next->status = status;
     current->next->next = NULL;
     current->next->pid = pid;
+    current->next->start_ns = now_ns();
     list->length++;
     return 0;
 }
@@ -76,7 +87,7 @@ int job_list_remove(job_list_t *list, unsigned idx) {
     if (idx == 0) {
         job_t *temp = list->head;
         list->head = list->head->next;
-        free(temp);
+        mem_free(MEM_JOBS, temp, sizeof(job_t));
         list->length--;
         return 0;
     }
@@ -87,7 +98,7 @@ int job_list_remove(job_list_t *list, unsigned idx) {
     }
     job_t *temp = current->next;
     current->next = current->next->next;
-    free(temp);
+    mem_free(MEM_JOBS, temp, sizeof(job_t));
     list->length--;
     return 0;
 }
@@ -97,7 +108,7 @@ void job_list_remove_by_status(job_list_t *list, job_status_t status) {
         job_t *temp = list->head;
         list->head = list->head->next;
         list->length--;
-        free(temp);
+        mem_free(MEM_JOBS, temp, sizeof(job_t));
     }
 
     if (list->head != NULL) {    // Could have removed all nodes in loop above
@@ -107,7 +118,7 @@ void job_list_remove_by_status(job_list_t *list, job_status_t status) {
                 job_t *temp = current->next;
                 current->next = current->next->next;
                 list->length--;
-                free(temp);
+                mem_free(MEM_JOBS, temp, sizeof(job_t));
             } else {
                 current = current->next;
             }
@@ -4,6 +4,7 @@
 #ifndef JOB_LIST_H
 #define JOB_LIST_H
 
+#include <stdint.h>
 #include <stdlib.h>
 #include <sys/types.h>
 
@@ -12,12 +13,14 @@
 typedef enum {
     STOPPED,
     BACKGROUND,
+    COPROC,
 } job_status_t;
 
 typedef struct job {
     char name[NAME_LEN];
     int status;
     pid_t pid;
+    uint64_t start_ns;    // When the job was added, in nanoseconds of CLOCK_MONOTONIC
     struct job *next;
 } job_t;
 
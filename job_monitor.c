@@ -0,0 +1,324 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#define _GNU_SOURCE
+
+#include "job_monitor.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PROC_BUF_SIZE 1024
+#define CELL_LEN 32
+#define DEFAULT_SCREEN_ROWS 24
+#define FIRST_JOB_ROW 3    // Below the title and header lines
+
+typedef enum {
+    COL_ID,
+    COL_PID,
+    COL_NAME,
+    COL_STATE,
+    COL_CPU,
+    COL_RSS,
+    COL_READ,
+    COL_WRITE,
+    NUM_COLS,
+} column_t;
+
+static const struct {
+    const char *title;
+    int width;
+} columns[NUM_COLS] = {
+    {"ID", 4},    {"PID", 8},   {"NAME", 20}, {"STATE", 9},
+    {"CPU%", 7},  {"RSS", 8},   {"READ", 8},  {"WRITE", 8},
+};
+
+typedef struct {
+    job_t *job;
+    int stat_fd;    // Kept open across refreshes; -1 until first needed
+    int io_fd;
+    int opened;
+    unsigned long long cpu_ticks;    // utime + stime at the previous sample
+    int have_ticks;
+    char cells[NUM_COLS][CELL_LEN];    // Text currently on screen
+} job_row_t;
+
+static double seconds_since(const struct timespec *then, const struct timespec *now) {
+    return (now->tv_sec - then->tv_sec) + (now->tv_nsec - then->tv_nsec) / 1e9;
+}
+
+static int column_start(column_t col) {
+    int start = 1;
+    for (int i = 0; i < col; i++) {
+        start += columns[i].width + 1;
+    }
+    return start;
+}
+
+static void format_bytes(char *cell, unsigned long long bytes) {
+    const char *units = "KMGT";
+    if (bytes < 1024) {
+        snprintf(cell, CELL_LEN, "%lluB", bytes);
+        return;
+    }
+    double value = bytes / 1024.0;
+    int unit = 0;
+    while (value >= 1024 && units[unit + 1] != '\0') {
+        value /= 1024;
+        unit++;
+    }
+    snprintf(cell, CELL_LEN, "%.1f%c", value, units[unit]);
+}
+
+static const char *state_name(char state) {
+    switch (state) {
+        case 'R':
+            return "running";
+        case 'S':
+            return "sleeping";
+        case 'D':
+            return "disk wait";
+        case 'T':
+        case 't':
+            return "stopped";
+        case 'Z':
+            return "zombie";
+        case 'I':
+            return "idle";
+        default:
+            return "exited";
+    }
+}
+
+static void open_row(job_row_t *row) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/stat", row->job->pid);
+    row->stat_fd = open(path, O_RDONLY | O_CLOEXEC);
+    snprintf(path, sizeof(path), "/proc/%d/io", row->job->pid);
+    row->io_fd = open(path, O_RDONLY | O_CLOEXEC);
+    row->opened = 1;
+}
+
+static void close_row(job_row_t *row) {
+    if (row->stat_fd != -1) {
+        close(row->stat_fd);
+    }
+    if (row->io_fd != -1) {
+        close(row->io_fd);
+    }
+}
+
+// Read a whole /proc file from the start into 'buf'
+// Returns the number of bytes read, or -1 if the process is gone or the file is unreadable
+static ssize_t read_proc(int fd, char *buf) {
+    if (fd == -1) {
+        return -1;
+    }
+    ssize_t n = pread(fd, buf, PROC_BUF_SIZE - 1, 0);
+    if (n <= 0) {
+        return -1;
+    }
+    buf[n] = '\0';
+    return n;
+}
+
+// Fill in the text of every cell of a job's row from a fresh sample
+static void sample_row(job_row_t *row, unsigned idx, double elapsed, char cells[][CELL_LEN]) {
+    snprintf(cells[COL_ID], CELL_LEN, "%u", idx);
+    snprintf(cells[COL_PID], CELL_LEN, "%d", row->job->pid);
+    snprintf(cells[COL_NAME], CELL_LEN, "%s", row->job->name);
+    for (int col = COL_STATE; col < NUM_COLS; col++) {
+        strcpy(cells[col], "-");
+    }
+    if (!row->opened) {
+        open_row(row);
+    }
+
+    char buf[PROC_BUF_SIZE];
+    char state;
+    unsigned long long utime;
+    unsigned long long stime;
+    long rss_pages;
+    // The command name in parentheses may itself contain spaces or ')'
+    char *fields = read_proc(row->stat_fd, buf) != -1 ? strrchr(buf, ')') : NULL;
+    if (fields == NULL ||
+        sscanf(fields + 2,
+               "%c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu %*d %*d %*d %*d %*d %*d "
+               "%*u %*u %ld",
+               &state, &utime, &stime, &rss_pages) != 4) {
+        strcpy(cells[COL_STATE], state_name('X'));
+        row->have_ticks = 0;
+        return;
+    }
+
+    strcpy(cells[COL_STATE], state_name(state));
+    unsigned long long ticks = utime + stime;
+    if (row->have_ticks && elapsed > 0) {
+        double seconds = (ticks - row->cpu_ticks) / (double) sysconf(_SC_CLK_TCK);
+        snprintf(cells[COL_CPU], CELL_LEN, "%.1f", 100.0 * seconds / elapsed);
+    }
+    row->cpu_ticks = ticks;
+    row->have_ticks = 1;
+    format_bytes(cells[COL_RSS], (unsigned long long) rss_pages * sysconf(_SC_PAGESIZE));
+
+    if (read_proc(row->io_fd, buf) != -1) {
+        char *rchar = strstr(buf, "rchar: ");
+        char *wchar = strstr(buf, "wchar: ");
+        if (rchar != NULL && wchar != NULL) {
+            format_bytes(cells[COL_READ], strtoull(rchar + 7, NULL, 10));
+            format_bytes(cells[COL_WRITE], strtoull(wchar + 7, NULL, 10));
+        }
+    }
+}
+
+// Redraw one cell if its text differs from what is on screen
+static void draw_cell(int screen_row, column_t col, const char *text, char *on_screen) {
+    if (strcmp(text, on_screen) == 0) {
+        return;
+    }
+    printf("\033[%d;%dH%-*.*s", screen_row, column_start(col), columns[col].width,
+           columns[col].width, text);
+    strcpy(on_screen, text);
+}
+
+static void draw_frame(double interval, unsigned num_jobs, unsigned visible) {
+    printf("\033[H\033[2J");
+    printf("Every %.1fs: %u job%s. Press any key to return.", interval, num_jobs,
+           num_jobs == 1 ? "" : "s");
+    for (int col = 0; col < NUM_COLS; col++) {
+        printf("\033[%d;%dH%s", FIRST_JOB_ROW - 1, column_start(col), columns[col].title);
+    }
+    if (visible < num_jobs) {
+        printf("\033[%u;1H... %u more", FIRST_JOB_ROW + visible, num_jobs - visible);
+    }
+}
+
+static unsigned visible_rows(unsigned num_jobs) {
+    struct winsize size;
+    int rows = DEFAULT_SCREEN_ROWS;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_row > 0) {
+        rows = size.ws_row;
+    }
+    // Leave room for the title, header, and "more" lines
+    rows -= FIRST_JOB_ROW;
+    if (rows < 1) {
+        rows = 1;
+    }
+    return num_jobs <= rows ? num_jobs : rows;
+}
+
+int job_monitor_run(job_list_t *jobs, double interval) {
+    if (!isfinite(interval) || interval < JOB_MONITOR_MIN_INTERVAL ||
+        interval > JOB_MONITOR_MAX_INTERVAL) {
+        fprintf(stderr, "jobs: Refresh interval out of range: %g\n", interval);
+        return -1;
+    }
+    unsigned num_jobs = jobs->length;
+    job_row_t *rows = calloc(num_jobs > 0 ? num_jobs : 1, sizeof(job_row_t));
+    if (rows == NULL) {
+        perror("calloc");
+        return -1;
+    }
+    unsigned idx = 0;
+    for (job_t *current = jobs->head; current != NULL && idx < num_jobs;
+         current = current->next, idx++) {
+        rows[idx].job = current;
+        rows[idx].stat_fd = -1;
+        rows[idx].io_fd = -1;
+    }
+
+    // Read single keypresses without echoing them while the table is shown
+    struct termios saved_attrs;
+    int is_tty = isatty(STDIN_FILENO) && tcgetattr(STDIN_FILENO, &saved_attrs) == 0;
+    if (is_tty) {
+        struct termios attrs = saved_attrs;
+        attrs.c_lflag &= ~(ICANON | ECHO);
+        attrs.c_cc[VMIN] = 1;
+        attrs.c_cc[VTIME] = 0;
+        tcsetattr(STDIN_FILENO, TCSANOW, &attrs);
+    }
+    // Use the alternate screen so the shell's output is restored afterward, and hide the cursor
+    printf("\033[?1049h\033[?25l");
+
+    int status = 0;
+    // No row count matches this, so the first refresh draws the frame even with no jobs
+    unsigned visible = UINT_MAX;
+    struct timespec next_tick;
+    struct timespec last_sample;
+    clock_gettime(CLOCK_MONOTONIC, &next_tick);
+    last_sample = next_tick;
+    while (1) {
+        unsigned now_visible = visible_rows(num_jobs);
+        if (now_visible != visible) {
+            // First refresh or the terminal was resized: start from a blank screen
+            visible = now_visible;
+            draw_frame(interval, num_jobs, visible);
+            for (unsigned i = 0; i < num_jobs; i++) {
+                memset(rows[i].cells, 0, sizeof(rows[i].cells));
+            }
+        }
+
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double elapsed = seconds_since(&last_sample, &now);
+        last_sample = now;
+        for (unsigned i = 0; i < visible; i++) {
+            char cells[NUM_COLS][CELL_LEN];
+            sample_row(&rows[i], i, elapsed, cells);
+            for (int col = 0; col < NUM_COLS; col++) {
+                draw_cell(FIRST_JOB_ROW + i, col, cells[col], rows[i].cells[col]);
+            }
+        }
+        fflush(stdout);
+
+        // Schedule refreshes from a fixed start so they do not drift
+        next_tick.tv_sec += (time_t) interval;
+        next_tick.tv_nsec += (long) ((interval - (time_t) interval) * 1e9);
+        if (next_tick.tv_nsec >= 1000000000L) {
+            next_tick.tv_sec++;
+            next_tick.tv_nsec -= 1000000000L;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double wait = -seconds_since(&next_tick, &now);
+        if (wait < 0) {
+            // Fell behind (e.g., the shell was suspended); skip the missed refreshes
+            next_tick = now;
+            wait = 0;
+        }
+
+        struct pollfd pfd = {STDIN_FILENO, POLLIN, 0};
+        int ready = poll(&pfd, 1, (int) (wait * 1000));
+        if (ready == -1 && errno != EINTR) {
+            perror("poll");
+            status = -1;
+            break;
+        } else if (ready > 0) {
+            // Consume the keypress; without a terminal, leave the input for the shell
+            char key;
+            if (is_tty && read(STDIN_FILENO, &key, 1) == -1) {
+                perror("read");
+            }
+            break;
+        }
+    }
+
+    printf("\033[?25h\033[?1049l");
+    fflush(stdout);
+    if (is_tty) {
+        tcsetattr(STDIN_FILENO, TCSANOW, &saved_attrs);
+    }
+    for (unsigned i = 0; i < num_jobs; i++) {
+        close_row(&rows[i]);
+    }
+    free(rows);
+    return status;
+}
@@ -0,0 +1,27 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef JOB_MONITOR_H
+#define JOB_MONITOR_H
+
+#include "job_list.h"
+
+#define JOB_MONITOR_DEFAULT_INTERVAL 1.0
+#define JOB_MONITOR_MIN_INTERVAL 0.1
+// An hour, far below where the refresh time arithmetic could overflow
+#define JOB_MONITOR_MAX_INTERVAL 3600.0
+
+/*
+ * Show a live table of the shell's jobs with their state, CPU usage, resident
+ * memory, and bytes read and written, refreshed every 'interval' seconds until
+ * the user presses a key (or any input arrives on stdin).
+ * Each job's /proc/<pid>/stat and /proc/<pid>/io files are opened once and
+ * re-read with pread() on every refresh, and only the table cells whose text
+ * changed are redrawn.
+ * jobs: The shell's job list, which is not modified
+ * interval: Seconds between refreshes, e.g., 0.5, from JOB_MONITOR_MIN_INTERVAL
+ *   to JOB_MONITOR_MAX_INTERVAL
+ * Returns 0 on success or -1 on error
+ */
+int job_monitor_run(job_list_t *jobs, double interval);
+
+#endif    // JOB_MONITOR_H
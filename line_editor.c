@@ -0,0 +1,451 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#define _GNU_SOURCE
+
+#include "line_editor.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "completion.h"
+#include "history.h"
+#include "string_vector.h"
+#include "variables.h"
+
+#define DEFAULT_WIDTH 80
+
+#define CTRL_KEY(c) ((c) & 0x1f)
+#define KEY_ESCAPE 0x1b
+#define KEY_BACKSPACE 0x7f
+
+typedef struct {
+    const char *prompt;
+    char *buf;    // Always null-terminated
+    size_t size;
+    size_t len;
+    size_t cursor;
+    int history_loaded;    // Entries are only counted once history is first recalled
+    unsigned history_pos;    // Entry shown, or num_history for the line being typed
+    unsigned num_history;
+    char *typed;    // The line being typed, saved while browsing history
+    int last_was_tab;
+} editor_t;
+
+static int watch_fd = -1;
+static void (*watch_callback)(void);
+
+static int use_raw_mode(void) {
+    const char *term = vars_get("TERM");
+    return isatty(STDIN_FILENO) && isatty(STDOUT_FILENO) && term != NULL && term[0] != '\0' &&
+           strcmp(term, "dumb") != 0;
+}
+
+// Redraw the prompt and line, then put the cursor back in place
+static void refresh(editor_t *ed) {
+    printf("\r%s", ed->prompt);
+    fwrite(ed->buf, 1, ed->len, stdout);
+    printf("\033[K");
+    if (ed->cursor < ed->len) {
+        printf("\033[%zuD", ed->len - ed->cursor);
+    }
+}
+
+// Block until stdin has input, handling the watched descriptor whenever it is ready meanwhile.
+// The callback may print, or start jobs that print, over the line, so 'ed' (NULL when not
+// editing) is redrawn after each call.
+static void wait_for_input(editor_t *ed) {
+    while (watch_fd != -1) {
+        struct pollfd fds[2] = {{STDIN_FILENO, POLLIN, 0}, {watch_fd, POLLIN, 0}};
+        if (poll(fds, 2, -1) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        if (fds[1].revents & POLLIN) {
+            watch_callback();
+            if (ed != NULL) {
+                refresh(ed);
+                fflush(stdout);
+            }
+        }
+        // End of input and errors are reported by the read that follows
+        if (fds[0].revents != 0) {
+            return;
+        }
+    }
+}
+
+// Read one byte from the terminal
+// Returns the byte, or -1 at the end of input or on error
+static int read_key(editor_t *ed) {
+    wait_for_input(ed);
+    unsigned char c;
+    ssize_t n;
+    while ((n = read(STDIN_FILENO, &c, 1)) == -1 && errno == EINTR) {
+    }
+    return n == 1 ? c : -1;
+}
+
+static void bell(void) {
+    fputc('\a', stdout);
+}
+
+// Read a line with read(2), a byte at a time, rather than through stdio. No input past the
+// line is held in a buffer, so poll() on stdin sees exactly what is left, and commands the
+// shell runs can read the rest of the input themselves.
+// Returns 0 on success or -1 at the end of input with nothing read
+static int read_plain_line(char *buf, size_t size) {
+    wait_for_input(NULL);
+    size_t len = 0;
+    while (len + 1 < size) {
+        char c;
+        ssize_t n = read(STDIN_FILENO, &c, 1);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        } else if (n != 1) {
+            if (len == 0) {
+                return -1;
+            }
+            break;
+        } else if (c == '\n') {
+            break;
+        }
+        buf[len++] = c;
+    }
+    buf[len] = '\0';
+    return 0;
+}
+
+// Replace the text between 'start' and the cursor with 'text'
+static void replace_before_cursor(editor_t *ed, size_t start, const char *text, size_t len) {
+    size_t old_len = ed->cursor - start;
+    if (ed->len - old_len + len >= ed->size) {
+        bell();
+        return;
+    }
+    // Typing at the end of the line needs no redraw
+    int append = ed->cursor == ed->len && len >= old_len &&
+                 memcmp(ed->buf + start, text, old_len) == 0;
+    memmove(ed->buf + start + len, ed->buf + ed->cursor, ed->len - ed->cursor + 1);
+    memcpy(ed->buf + start, text, len);
+    ed->len = ed->len - old_len + len;
+    ed->cursor = start + len;
+    if (append) {
+        fwrite(text + old_len, 1, len - old_len, stdout);
+    } else {
+        refresh(ed);
+    }
+}
+
+static void erase(editor_t *ed, size_t start, size_t end) {
+    memmove(ed->buf + start, ed->buf + end, ed->len - end + 1);
+    ed->len -= end - start;
+    if (ed->cursor > end) {
+        ed->cursor -= end - start;
+    } else if (ed->cursor > start) {
+        ed->cursor = start;
+    }
+    refresh(ed);
+}
+
+static void set_line(editor_t *ed, const char *text, size_t len) {
+    if (len >= ed->size) {
+        len = ed->size - 1;
+    }
+    memcpy(ed->buf, text, len);
+    ed->buf[len] = '\0';
+    ed->len = len;
+    ed->cursor = len;
+    refresh(ed);
+}
+
+static void recall_history(editor_t *ed, int older) {
+    if (!ed->history_loaded) {
+        ed->num_history = history_length();
+        ed->history_pos = ed->num_history;
+        ed->history_loaded = 1;
+    }
+    if ((older && ed->history_pos == 0) || (!older && ed->history_pos == ed->num_history)) {
+        bell();
+        return;
+    }
+    if (ed->history_pos == ed->num_history) {
+        free(ed->typed);
+        ed->typed = strdup(ed->buf);
+    }
+    ed->history_pos += older ? -1 : 1;
+    if (ed->history_pos < ed->num_history) {
+        unsigned len;
+        const char *entry = history_get(ed->history_pos, &len);
+        set_line(ed, entry, len);
+    } else if (ed->typed != NULL) {
+        set_line(ed, ed->typed, strlen(ed->typed));
+    } else {
+        set_line(ed, "", 0);
+    }
+}
+
+// Print completions in columns below the line, as ls does
+static void list_candidates(const strvec_t *candidates) {
+    struct winsize ws;
+    unsigned width = ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0
+                         ? ws.ws_col
+                         : DEFAULT_WIDTH;
+    unsigned shown = candidates->length;
+    if (shown > LINE_EDITOR_MAX_LIST) {
+        shown = LINE_EDITOR_MAX_LIST;
+    }
+    size_t col_width = 0;
+    for (unsigned i = 0; i < shown; i++) {
+        size_t len = strlen(candidates->data[i]);
+        if (len + 2 > col_width) {
+            col_width = len + 2;
+        }
+    }
+    unsigned cols = col_width < width ? width / col_width : 1;
+    unsigned rows = (shown + cols - 1) / cols;
+
+    printf("\n");
+    for (unsigned row = 0; row < rows; row++) {
+        for (unsigned col = 0; col < cols; col++) {
+            unsigned i = col * rows + row;
+            if (i < shown) {
+                printf("%-*s", (int) col_width, candidates->data[i]);
+            }
+        }
+        printf("\033[K\n");
+    }
+    if (shown < candidates->length) {
+        printf("(%u more)\n", candidates->length - shown);
+    }
+}
+
+static void complete(editor_t *ed) {
+    strvec_t candidates;
+    if (strvec_init(&candidates) == -1) {
+        return;
+    }
+    size_t start;
+    int num = completion_find(ed->buf, ed->cursor, &start, &candidates);
+    if (num <= 0) {
+        bell();
+    } else if (num == 1) {
+        const char *only = candidates.data[0];
+        size_t len = strlen(only);
+        // Finish the word, unless it names a directory whose contents may come next
+        char *word = malloc(len + 2);
+        if (word != NULL) {
+            memcpy(word, only, len);
+            if (only[len - 1] != '/') {
+                word[len++] = ' ';
+            }
+            replace_before_cursor(ed, start, word, len);
+            free(word);
+        }
+    } else {
+        // Fill in as much as all the choices share, or list them on a second Tab
+        size_t common = strlen(candidates.data[0]);
+        for (int i = 1; i < num; i++) {
+            size_t j = 0;
+            while (j < common && candidates.data[i][j] == candidates.data[0][j]) {
+                j++;
+            }
+            common = j;
+        }
+        if (common > ed->cursor - start) {
+            replace_before_cursor(ed, start, candidates.data[0], common);
+        } else if (ed->last_was_tab) {
+            list_candidates(&candidates);
+            refresh(ed);
+        } else {
+            bell();
+        }
+    }
+    strvec_clear(&candidates);
+}
+
+// Handle the rest of an escape sequence, e.g., "\033[A" for Up
+static void handle_escape(editor_t *ed) {
+    int c = read_key(ed);
+    if (c != '[' && c != 'O') {
+        return;
+    }
+    int final = read_key(ed);
+    int param = 0;
+    while (final >= '0' && final <= '9') {
+        param = param * 10 + (final - '0');
+        final = read_key(ed);
+    }
+    if (final == '~') {
+        final = param == 1 || param == 7 ? 'H' : param == 4 || param == 8 ? 'F' : param;
+    }
+
+    switch (final) {
+        case 'A':
+            recall_history(ed, 1);
+            break;
+        case 'B':
+            recall_history(ed, 0);
+            break;
+        case 'C':
+            if (ed->cursor < ed->len) {
+                ed->cursor++;
+                printf("\033[C");
+            }
+            break;
+        case 'D':
+            if (ed->cursor > 0) {
+                ed->cursor--;
+                printf("\033[D");
+            }
+            break;
+        case 'H':
+            ed->cursor = 0;
+            refresh(ed);
+            break;
+        case 'F':
+            ed->cursor = ed->len;
+            refresh(ed);
+            break;
+        case 3:    // Delete
+            if (ed->cursor < ed->len) {
+                erase(ed, ed->cursor, ed->cursor + 1);
+            }
+            break;
+    }
+}
+
+// Edit a line until Enter is pressed
+// Returns 0 on success or -1 at the end of input
+static int edit_line(editor_t *ed) {
+    while (1) {
+        fflush(stdout);
+        int c = read_key(ed);
+        if (c == -1) {
+            return ed->len > 0 ? 0 : -1;
+        }
+        int is_tab = c == '\t';
+
+        switch (c) {
+            case '\r':
+            case '\n':
+                printf("\n");
+                return 0;
+            case '\t':
+                complete(ed);
+                break;
+            case CTRL_KEY('C'):
+                printf("^C\n");
+                ed->len = 0;
+                ed->cursor = 0;
+                ed->buf[0] = '\0';
+                ed->history_pos = ed->num_history;
+                refresh(ed);
+                break;
+            case CTRL_KEY('D'):
+                if (ed->len == 0) {
+                    printf("\n");
+                    return -1;
+                } else if (ed->cursor < ed->len) {
+                    erase(ed, ed->cursor, ed->cursor + 1);
+                }
+                break;
+            case CTRL_KEY('H'):
+            case KEY_BACKSPACE:
+                if (ed->cursor > 0) {
+                    erase(ed, ed->cursor - 1, ed->cursor);
+                }
+                break;
+            case CTRL_KEY('A'):
+                ed->cursor = 0;
+                refresh(ed);
+                break;
+            case CTRL_KEY('E'):
+                ed->cursor = ed->len;
+                refresh(ed);
+                break;
+            case CTRL_KEY('B'):
+                if (ed->cursor > 0) {
+                    ed->cursor--;
+                    printf("\033[D");
+                }
+                break;
+            case CTRL_KEY('F'):
+                if (ed->cursor < ed->len) {
+                    ed->cursor++;
+                    printf("\033[C");
+                }
+                break;
+            case CTRL_KEY('U'):
+                erase(ed, 0, ed->cursor);
+                break;
+            case CTRL_KEY('K'):
+                erase(ed, ed->cursor, ed->len);
+                break;
+            case CTRL_KEY('L'):
+                printf("\033[H\033[2J");
+                refresh(ed);
+                break;
+            case CTRL_KEY('P'):
+                recall_history(ed, 1);
+                break;
+            case CTRL_KEY('N'):
+                recall_history(ed, 0);
+                break;
+            case KEY_ESCAPE:
+                handle_escape(ed);
+                break;
+            default:
+                if (c >= ' ') {
+                    char ch = c;
+                    replace_before_cursor(ed, ed->cursor, &ch, 1);
+                }
+                break;
+        }
+        ed->last_was_tab = is_tab;
+    }
+}
+
+void line_editor_watch(int fd, void (*callback)(void)) {
+    watch_fd = fd;
+    watch_callback = callback;
+}
+
+int line_editor_read(const char *prompt, char *buf, size_t size) {
+    struct termios saved_attrs;
+    if (!use_raw_mode() || tcgetattr(STDIN_FILENO, &saved_attrs) == -1) {
+        printf("%s", prompt);
+        fflush(stdout);
+        return read_plain_line(buf, size);
+    }
+
+    // Take keys one at a time, unechoed, with Ctrl-C and Ctrl-Z delivered as input. Output
+    // processing stays on, so "\n" still moves to the start of the next line.
+    struct termios attrs = saved_attrs;
+    attrs.c_lflag &= ~(ICANON | ECHO | ISIG | IEXTEN);
+    attrs.c_iflag &= ~(IXON | ICRNL);
+    attrs.c_cc[VMIN] = 1;
+    attrs.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSANOW, &attrs);
+
+    editor_t ed;
+    memset(&ed, 0, sizeof(ed));
+    ed.prompt = prompt;
+    ed.buf = buf;
+    ed.size = size;
+    buf[0] = '\0';
+    printf("%s", prompt);
+
+    int status = edit_line(&ed);
+    fflush(stdout);
+    tcsetattr(STDIN_FILENO, TCSANOW, &saved_attrs);
+    free(ed.typed);
+    return status;
+}
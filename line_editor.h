@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef LINE_EDITOR_H
+#define LINE_EDITOR_H
+
+#include <stddef.h>
+
+// Most completions listed at once when Tab is pressed twice
+#define LINE_EDITOR_MAX_LIST 100
+
+/*
+ * Print 'prompt' and read one line of input, without its newline.
+ * If stdin is a terminal and TERM is set to something other than "dumb", the
+ * line is edited in raw mode:
+ *   Left/Right, Home/End, Ctrl-A/Ctrl-E   Move the cursor
+ *   Backspace, Delete                     Erase a character
+ *   Ctrl-U, Ctrl-K                        Erase to the start or end of the line
+ *   Up/Down, Ctrl-P/Ctrl-N                Recall older or newer history entries
+ *   Tab                                   Complete the word before the cursor,
+ *                                         or list the choices if pressed twice
+ *   Ctrl-C                                Abandon the line
+ *   Ctrl-D                                End input if the line is empty
+ * Otherwise the line is read with read(2), one byte at a time, so that input
+ * after the line stays unread for the commands the shell runs.
+ * prompt: Prompt to print before the line
+ * buf: Buffer to store the line in
+ * size: Size of 'buf', including the null terminator
+ * Returns 0 on success or -1 at the end of input
+ */
+int line_editor_read(const char *prompt, char *buf, size_t size);
+
+/*
+ * Have line_editor_read() call 'callback' whenever 'fd' becomes readable while
+ * it waits for input, e.g., to run timers while the shell is idle at a prompt
+ * fd: Descriptor to watch, or -1 to stop watching
+ * callback: Called with the descriptor readable; it must make it unreadable
+ *   again (e.g., by reading from it) or it is called repeatedly
+ */
+void line_editor_watch(int fd, void (*callback)(void));
+
+#endif    // LINE_EDITOR_H
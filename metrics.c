@@ -0,0 +1,292 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#define _GNU_SOURCE
+
+#include "metrics.h"
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "swish_funcs.h"
+
+// Each power of two is split into 2^SUB_BITS equal buckets; values below 2^(SUB_BITS + 1)
+// each get a bucket of their own
+#define SUB_BITS 4
+#define SUB_BUCKETS (1 << SUB_BITS)
+#define NUM_BUCKETS ((64 - SUB_BITS + 1) * SUB_BUCKETS)
+
+typedef struct {
+    atomic_uint_least64_t sum;
+    atomic_uint_least64_t max;
+    atomic_uint_least64_t buckets[NUM_BUCKETS];
+} histogram_t;
+
+static const struct {
+    const char *name;
+    const char *help;
+} counter_info[NUM_COUNTERS] = {
+    {"swish_commands_total", "Command lines run"},
+    {"swish_external_commands_total", "Commands run as a child process"},
+    {"swish_fork_failures_total", "Failed calls to fork()"},
+    {"swish_exec_failures_total", "Foreground jobs whose program could not be executed"},
+};
+
+static const struct {
+    const char *name;
+    const char *help;
+} histogram_info[NUM_HISTOGRAMS] = {
+    {"swish_spawn_latency_seconds", "Time taken by fork() in the shell"},
+    {"swish_wait_time_seconds", "Time the shell spent waiting for jobs"},
+    {"swish_job_duration_seconds", "Time from starting a job until it terminated"},
+};
+
+static const double quantiles[] = {0.5, 0.9, 0.99};
+#define NUM_QUANTILES (sizeof(quantiles) / sizeof(quantiles[0]))
+
+static atomic_uint_least64_t counters[NUM_COUNTERS];
+static histogram_t histograms[NUM_HISTOGRAMS];
+
+uint64_t metrics_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+void metrics_count(metric_counter_t counter) {
+    atomic_fetch_add_explicit(&counters[counter], 1, memory_order_relaxed);
+}
+
+static unsigned bucket_index(uint64_t value) {
+    if (value < 2 * SUB_BUCKETS) {
+        return value;
+    }
+    unsigned exponent = 63 - __builtin_clzll(value);
+    unsigned shift = exponent - SUB_BITS;
+    return (shift + 1) * SUB_BUCKETS + (unsigned) (value >> shift) - SUB_BUCKETS;
+}
+
+// Smallest value that falls in a bucket
+static uint64_t bucket_lower_bound(unsigned index) {
+    if (index < 2 * SUB_BUCKETS) {
+        return index;
+    }
+    unsigned shift = index / SUB_BUCKETS - 1;
+    return (uint64_t) (index % SUB_BUCKETS + SUB_BUCKETS) << shift;
+}
+
+void metrics_record(metric_histogram_t histogram, uint64_t nanoseconds) {
+    histogram_t *h = &histograms[histogram];
+    atomic_fetch_add_explicit(&h->buckets[bucket_index(nanoseconds)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->sum, nanoseconds, memory_order_relaxed);
+    uint64_t max = atomic_load_explicit(&h->max, memory_order_relaxed);
+    while (nanoseconds > max && !atomic_compare_exchange_weak_explicit(
+                                    &h->max, &max, nanoseconds, memory_order_relaxed,
+                                    memory_order_relaxed)) {
+    }
+}
+
+void metrics_job_done(uint64_t start_ns, int status) {
+    if (WIFSTOPPED(status)) {
+        return;
+    }
+    metrics_record(METRIC_JOB_DURATION, metrics_now() - start_ns);
+}
+
+// Estimate a quantile from a snapshot of a histogram's buckets, as the midpoint of the
+// bucket that contains it (or the exact value for the small, single-value buckets)
+static double quantile(const uint64_t *buckets, uint64_t count, double q) {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t) (q * count);
+    if (rank >= count) {
+        rank = count - 1;
+    }
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < NUM_BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen > rank) {
+            uint64_t low = bucket_lower_bound(i);
+            uint64_t high = i + 1 < NUM_BUCKETS ? bucket_lower_bound(i + 1) : low;
+            return (low + high) / 2.0;
+        }
+    }
+    return 0;
+}
+
+typedef struct {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    double quantiles[NUM_QUANTILES];
+} histogram_summary_t;
+
+static void summarize(metric_histogram_t histogram, histogram_summary_t *summary) {
+    histogram_t *h = &histograms[histogram];
+    uint64_t buckets[NUM_BUCKETS];
+    uint64_t count = 0;
+    for (unsigned i = 0; i < NUM_BUCKETS; i++) {
+        buckets[i] = atomic_load_explicit(&h->buckets[i], memory_order_relaxed);
+        count += buckets[i];
+    }
+    summary->count = count;
+    summary->sum = atomic_load_explicit(&h->sum, memory_order_relaxed);
+    summary->max = atomic_load_explicit(&h->max, memory_order_relaxed);
+    for (unsigned i = 0; i < NUM_QUANTILES; i++) {
+        // A bucket's midpoint can lie above the largest value actually recorded
+        summary->quantiles[i] = quantile(buckets, count, quantiles[i]);
+        if (summary->quantiles[i] > summary->max) {
+            summary->quantiles[i] = summary->max;
+        }
+    }
+}
+
+static void print_stats(void) {
+    uint64_t commands = atomic_load(&counters[METRIC_COMMANDS]);
+    uint64_t external = atomic_load(&counters[METRIC_EXTERNAL]);
+    printf("commands: %llu (builtin %llu, external %llu)\n", (unsigned long long) commands,
+           (unsigned long long) (commands - external), (unsigned long long) external);
+    printf("fork failures: %llu\n",
+           (unsigned long long) atomic_load(&counters[METRIC_FORK_FAILURES]));
+    printf("exec failures: %llu\n",
+           (unsigned long long) atomic_load(&counters[METRIC_EXEC_FAILURES]));
+
+    static const char *labels[NUM_HISTOGRAMS] = {"spawn latency", "wait time", "job duration"};
+    for (int i = 0; i < NUM_HISTOGRAMS; i++) {
+        histogram_summary_t s;
+        summarize(i, &s);
+        printf("%s: n=%llu", labels[i], (unsigned long long) s.count);
+        if (s.count > 0) {
+            printf(" mean=%.3fms p50=%.3fms p90=%.3fms p99=%.3fms max=%.3fms",
+                   s.sum / (double) s.count / 1e6, s.quantiles[0] / 1e6, s.quantiles[1] / 1e6,
+                   s.quantiles[2] / 1e6, s.max / 1e6);
+        }
+        printf("\n");
+    }
+}
+
+// Write all metrics in the Prometheus text exposition format
+static int write_prometheus(FILE *out) {
+    fprintf(out, "# HELP swish_builtin_commands_total Commands run inside the shell\n");
+    fprintf(out, "# TYPE swish_builtin_commands_total counter\n");
+    fprintf(out, "swish_builtin_commands_total %llu\n",
+            (unsigned long long) (atomic_load(&counters[METRIC_COMMANDS]) -
+                                  atomic_load(&counters[METRIC_EXTERNAL])));
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        fprintf(out, "# HELP %s %s\n# TYPE %s counter\n%s %llu\n", counter_info[i].name,
+                counter_info[i].help, counter_info[i].name, counter_info[i].name,
+                (unsigned long long) atomic_load(&counters[i]));
+    }
+    for (int i = 0; i < NUM_HISTOGRAMS; i++) {
+        const char *name = histogram_info[i].name;
+        histogram_summary_t s;
+        summarize(i, &s);
+        fprintf(out, "# HELP %s %s\n# TYPE %s summary\n", name, histogram_info[i].help, name);
+        for (unsigned q = 0; q < NUM_QUANTILES; q++) {
+            fprintf(out, "%s{quantile=\"%g\"} %.9f\n", name, quantiles[q], s.quantiles[q] / 1e9);
+        }
+        fprintf(out, "%s_sum %.9f\n%s_count %llu\n", name, s.sum / 1e9, name,
+                (unsigned long long) s.count);
+    }
+    return ferror(out) ? -1 : 0;
+}
+
+// Write the metrics to a temporary file, then rename it over 'path' so that a scraper never
+// sees a partly written file
+static int dump_to_file(const char *path) {
+    char *tmp_path;
+    if (asprintf(&tmp_path, "%s.tmp.%d", path, getpid()) == -1) {
+        perror("asprintf");
+        return -1;
+    }
+    FILE *out = fopen(tmp_path, "w");
+    if (out == NULL) {
+        perror("fopen");
+        free(tmp_path);
+        return -1;
+    }
+    int status = write_prometheus(out);
+    if (fclose(out) == EOF) {
+        status = -1;
+    }
+    if (status == -1) {
+        perror("write");
+        unlink(tmp_path);
+    } else if (rename(tmp_path, path) == -1) {
+        perror("rename");
+        unlink(tmp_path);
+        status = -1;
+    }
+    free(tmp_path);
+    return status;
+}
+
+static int dump_to_socket(const char *path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "stats: Socket path is too long\n");
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        perror("socket");
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == -1) {
+        perror("connect");
+        close(fd);
+        return -1;
+    }
+
+    // Format into memory first; send() with MSG_NOSIGNAL so a scraper that hangs up early
+    // cannot kill the shell with SIGPIPE
+    char *text = NULL;
+    size_t len = 0;
+    FILE *out = open_memstream(&text, &len);
+    if (out == NULL) {
+        perror("open_memstream");
+        close(fd);
+        return -1;
+    }
+    int status = write_prometheus(out);
+    if (fclose(out) == EOF) {
+        status = -1;
+    }
+    for (size_t sent = 0; status == 0 && sent < len;) {
+        ssize_t n = send(fd, text + sent, len - sent, MSG_NOSIGNAL);
+        if (n == -1 && errno != EINTR) {
+            perror("send");
+            status = -1;
+        } else if (n > 0) {
+            sent += n;
+        }
+    }
+    free(text);
+    close(fd);
+    return status;
+}
+
+int metrics_command(const strvec_t *tokens) {
+    if (tokens->length == 1) {
+        print_stats();
+        return 0;
+    } else if (tokens->length == 3 && strcmp(tokens->data[1], "--prom") == 0) {
+        return dump_to_file(tokens->data[2]);
+    } else if (tokens->length == 3 && strcmp(tokens->data[1], "--prom-socket") == 0) {
+        return dump_to_socket(tokens->data[2]);
+    }
+    fprintf(stderr, "stats: Usage: stats [--prom FILE | --prom-socket PATH]\n");
+    return -1;
+}
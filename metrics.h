@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+
+#include "string_vector.h"
+
+typedef enum {
+    METRIC_COMMANDS,         // Command lines run, builtin or not
+    METRIC_EXTERNAL,         // Commands run as a child process
+    METRIC_FORK_FAILURES,
+    METRIC_EXEC_FAILURES,    // Foreground jobs whose program could not be executed
+    NUM_COUNTERS,
+} metric_counter_t;
+
+typedef enum {
+    METRIC_SPAWN_LATENCY,    // Time taken by fork() in the shell
+    METRIC_WAIT_TIME,        // Time the shell spent blocked waiting for a job
+    METRIC_JOB_DURATION,     // Time from starting a job until it terminated
+    NUM_HISTOGRAMS,
+} metric_histogram_t;
+
+/*
+ * Get the current time of the monotonic clock in nanoseconds
+ */
+uint64_t metrics_now(void);
+
+/*
+ * Add one to a counter. Safe to call from any thread.
+ * counter: The counter to increment
+ */
+void metrics_count(metric_counter_t counter);
+
+/*
+ * Record one value in a histogram. Values are kept in log-linear buckets
+ * (16 per power of two), so quantiles are accurate to about 6%. Safe to call
+ * from any thread.
+ * histogram: The histogram to record in
+ * nanoseconds: The value to record
+ */
+void metrics_record(metric_histogram_t histogram, uint64_t nanoseconds);
+
+/*
+ * Record that a job the shell was waiting on has stopped or terminated. For
+ * a job that terminated, record its duration.
+ * start_ns: When the job was started, from metrics_now()
+ * status: Status of the job's process as reported by waitpid()
+ */
+void metrics_job_done(uint64_t start_ns, int status);
+
+/*
+ * The "stats" builtin: stats [--prom FILE | --prom-socket PATH]
+ * Prints all counters and histogram summaries, or writes them in Prometheus
+ * text format to FILE (replaced atomically) or to the Unix stream socket
+ * listening at PATH
+ * tokens: Tokens typed by the user, e.g., "stats --prom /tmp/swish.prom"
+ * Returns 0 on success or -1 on error
+ */
+int metrics_command(const strvec_t *tokens);
+
+#endif    // METRICS_H
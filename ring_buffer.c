@@ -0,0 +1,138 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "ring_buffer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+int ring_init(ring_buffer_t *rb, size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    if ((rb->data = malloc(size)) == NULL) {
+        return -1;
+    }
+    rb->capacity = size;
+    atomic_init(&rb->head, 0);
+    atomic_init(&rb->tail, 0);
+    atomic_init(&rb->write_closed, 0);
+    atomic_init(&rb->read_closed, 0);
+    atomic_init(&rb->reader_waiting, 0);
+    atomic_init(&rb->writer_waiting, 0);
+    pthread_mutex_init(&rb->lock, NULL);
+    pthread_cond_init(&rb->readable, NULL);
+    pthread_cond_init(&rb->writable, NULL);
+    return 0;
+}
+
+void ring_destroy(ring_buffer_t *rb) {
+    free(rb->data);
+    rb->data = NULL;
+    pthread_mutex_destroy(&rb->lock);
+    pthread_cond_destroy(&rb->readable);
+    pthread_cond_destroy(&rb->writable);
+}
+
+// Wake the other side only if it has announced that it is sleeping. The
+// waiting flag is set before the sleeper re-checks the ring, and the position
+// update happens before this check, so at least one of them sees the other.
+static void ring_wake(ring_buffer_t *rb, atomic_int *waiting, pthread_cond_t *cond) {
+    if (atomic_load(waiting)) {
+        pthread_mutex_lock(&rb->lock);
+        pthread_cond_signal(cond);
+        pthread_mutex_unlock(&rb->lock);
+    }
+}
+
+ssize_t ring_read(ring_buffer_t *rb, void *buf, size_t len) {
+    size_t head = atomic_load_explicit(&rb->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&rb->tail, memory_order_acquire);
+
+    if (tail == head) {
+        pthread_mutex_lock(&rb->lock);
+        atomic_store(&rb->reader_waiting, 1);
+        while ((tail = atomic_load(&rb->tail)) == head && !atomic_load(&rb->write_closed)) {
+            pthread_cond_wait(&rb->readable, &rb->lock);
+        }
+        atomic_store(&rb->reader_waiting, 0);
+        pthread_mutex_unlock(&rb->lock);
+        if (tail == head) {
+            return 0;    // Writer closed and ring drained
+        }
+    }
+
+    size_t available = tail - head;
+    if (len > available) {
+        len = available;
+    }
+    size_t offset = head & (rb->capacity - 1);
+    size_t first = rb->capacity - offset;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(buf, rb->data + offset, first);
+    memcpy((char *) buf + first, rb->data, len - first);
+
+    atomic_store(&rb->head, head + len);
+    ring_wake(rb, &rb->writer_waiting, &rb->writable);
+    return len;
+}
+
+int ring_write(ring_buffer_t *rb, const void *buf, size_t len) {
+    const char *src = buf;
+    size_t tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+
+    while (len > 0) {
+        if (atomic_load(&rb->read_closed)) {
+            return -1;
+        }
+
+        size_t head = atomic_load_explicit(&rb->head, memory_order_acquire);
+        if (tail - head == rb->capacity) {
+            pthread_mutex_lock(&rb->lock);
+            atomic_store(&rb->writer_waiting, 1);
+            while (tail - atomic_load(&rb->head) == rb->capacity &&
+                   !atomic_load(&rb->read_closed)) {
+                pthread_cond_wait(&rb->writable, &rb->lock);
+            }
+            atomic_store(&rb->writer_waiting, 0);
+            pthread_mutex_unlock(&rb->lock);
+            continue;
+        }
+
+        size_t chunk = rb->capacity - (tail - head);
+        if (chunk > len) {
+            chunk = len;
+        }
+        size_t offset = tail & (rb->capacity - 1);
+        size_t first = rb->capacity - offset;
+        if (first > chunk) {
+            first = chunk;
+        }
+        memcpy(rb->data + offset, src, first);
+        memcpy(rb->data, src + first, chunk - first);
+
+        tail += chunk;
+        src += chunk;
+        len -= chunk;
+        atomic_store(&rb->tail, tail);
+        ring_wake(rb, &rb->reader_waiting, &rb->readable);
+    }
+    return 0;
+}
+
+void ring_close_write(ring_buffer_t *rb) {
+    pthread_mutex_lock(&rb->lock);
+    atomic_store(&rb->write_closed, 1);
+    pthread_cond_broadcast(&rb->readable);
+    pthread_mutex_unlock(&rb->lock);
+}
+
+void ring_close_read(ring_buffer_t *rb) {
+    pthread_mutex_lock(&rb->lock);
+    atomic_store(&rb->read_closed, 1);
+    pthread_cond_broadcast(&rb->writable);
+    pthread_mutex_unlock(&rb->lock);
+}
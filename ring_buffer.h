@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/*
+ * Single-producer, single-consumer byte ring used to connect two builtin
+ * filter stages running as threads in the same process. The read and write
+ * positions are lock-free; the mutex and condition variables are only used
+ * to sleep when the ring is empty (reader) or full (writer).
+ */
+typedef struct {
+    char *data;
+    size_t capacity;    // Always a power of two
+    _Atomic size_t head;    // Total bytes consumed
+    _Atomic size_t tail;    // Total bytes produced
+    atomic_int write_closed;
+    atomic_int read_closed;
+    atomic_int reader_waiting;
+    atomic_int writer_waiting;
+    pthread_mutex_t lock;
+    pthread_cond_t readable;
+    pthread_cond_t writable;
+} ring_buffer_t;
+
+/*
+ * Initialize an empty ring buffer
+ * rb: Pointer to the ring buffer to initialize
+ * capacity: Requested size in bytes, rounded up to a power of two
+ * Returns 0 on success or -1 on error
+ */
+int ring_init(ring_buffer_t *rb, size_t capacity);
+
+/*
+ * Free the memory held by a ring buffer. Neither side may still be using it.
+ * rb: Pointer to the ring buffer to destroy
+ */
+void ring_destroy(ring_buffer_t *rb);
+
+/*
+ * Read up to 'len' bytes from a ring buffer, blocking while it is empty
+ * rb: Pointer to the ring buffer to read from
+ * buf: Destination for the bytes read
+ * len: Maximum number of bytes to read
+ * Returns the number of bytes read, or 0 once the writer has closed its end
+ * and all data has been consumed
+ */
+ssize_t ring_read(ring_buffer_t *rb, void *buf, size_t len);
+
+/*
+ * Write all 'len' bytes to a ring buffer, blocking while it is full
+ * rb: Pointer to the ring buffer to write to
+ * buf: Bytes to write
+ * len: Number of bytes to write
+ * Returns 0 on success or -1 if the reader has closed its end
+ */
+int ring_write(ring_buffer_t *rb, const void *buf, size_t len);
+
+/*
+ * Signal end-of-input to the reader of a ring buffer
+ * rb: Pointer to the ring buffer
+ */
+void ring_close_write(ring_buffer_t *rb);
+
+/*
+ * Signal the writer of a ring buffer that no more data will be consumed
+ * rb: Pointer to the ring buffer
+ */
+void ring_close_read(ring_buffer_t *rb);
+
+#endif    // RING_BUFFER_H
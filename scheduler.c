@@ -0,0 +1,508 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#define _GNU_SOURCE
+
+#include "scheduler.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "metrics.h"
+#include "swish_funcs.h"
+
+#define SLOT_MASK (SCHEDULER_WHEEL_SLOTS - 1)
+#define BITMAP_WORDS (SCHEDULER_WHEEL_SLOTS / 64)
+#define INTERVAL_TEXT_LEN 16
+#define NS_PER_SEC 1000000000ULL
+
+// What to do when a run comes due while the schedule's previous run is still going
+typedef enum {
+    OVERLAP_ALLOW,    // Start it anyway
+    OVERLAP_SKIP,     // --no-overlap: skip it
+    OVERLAP_QUEUE,    // --queue: start it when the previous run finishes
+} overlap_t;
+
+static const char *overlap_names[] = {"allow", "skip", "queue"};
+
+typedef struct schedule {
+    unsigned id;
+    strvec_t command;
+    char interval_text[INTERVAL_TEXT_LEN];    // As typed, e.g., "5s"
+    uint64_t interval_ns;
+    uint64_t next_ns;     // When the next run is due, on the monotonic clock
+    uint64_t due_tick;    // Wheel tick at or after next_ns
+    overlap_t overlap;
+    unsigned running;     // Runs started and not yet finished
+    int queued;           // A run is waiting for the previous one to finish
+    unsigned long long runs;
+    unsigned long long skipped;
+    struct schedule *slot_next;    // Neighbors in its wheel slot
+    struct schedule *slot_prev;
+    struct schedule *next;    // Neighbors in the list of all schedules, in order of ID
+    struct schedule *prev;
+} schedule_t;
+
+// A run started by a schedule that has not been collected yet
+typedef struct {
+    pid_t pid;
+    schedule_t *schedule;
+} run_t;
+
+static struct {
+    int fd;
+    job_list_t *jobs;
+    scheduler_launch_t launch;
+    void *arg;
+    uint64_t base_ns;         // Time of tick 0
+    uint64_t current_tick;    // Last tick whose slot has been processed
+    schedule_t *slots[SCHEDULER_WHEEL_SLOTS];
+    uint64_t occupied[BITMAP_WORDS];    // One bit per slot with any schedules in it
+    schedule_t *head;
+    schedule_t *tail;
+    unsigned next_id;
+    run_t *runs;
+    unsigned num_runs;
+    unsigned runs_capacity;
+} sched = {.fd = -1};
+
+// First tick at or after a time
+static uint64_t tick_at_or_after(uint64_t ns) {
+    return ns <= sched.base_ns ? 0 : (ns - sched.base_ns + SCHEDULER_TICK_NS - 1) / SCHEDULER_TICK_NS;
+}
+
+static void wheel_insert(schedule_t *s) {
+    uint64_t tick = tick_at_or_after(s->next_ns);
+    if (tick <= sched.current_tick) {
+        tick = sched.current_tick + 1;
+    }
+    s->due_tick = tick;
+
+    unsigned slot = tick & SLOT_MASK;
+    s->slot_prev = NULL;
+    s->slot_next = sched.slots[slot];
+    if (s->slot_next != NULL) {
+        s->slot_next->slot_prev = s;
+    }
+    sched.slots[slot] = s;
+    sched.occupied[slot / 64] |= 1ULL << (slot % 64);
+}
+
+static void wheel_remove(schedule_t *s) {
+    unsigned slot = s->due_tick & SLOT_MASK;
+    if (s->slot_prev != NULL) {
+        s->slot_prev->slot_next = s->slot_next;
+    } else {
+        sched.slots[slot] = s->slot_next;
+    }
+    if (s->slot_next != NULL) {
+        s->slot_next->slot_prev = s->slot_prev;
+    }
+    if (sched.slots[slot] == NULL) {
+        sched.occupied[slot / 64] &= ~(1ULL << (slot % 64));
+    }
+}
+
+// Number of ticks after 'tick' until the next occupied slot, from 1 to a whole turn of the
+// wheel, or 0 if the wheel is empty
+static unsigned next_occupied(uint64_t tick) {
+    unsigned start = (tick + 1) & SLOT_MASK;
+    for (unsigned i = 0; i <= BITMAP_WORDS; i++) {
+        unsigned word = (start / 64 + i) % BITMAP_WORDS;
+        uint64_t bits = sched.occupied[word];
+        if (i == 0) {
+            bits &= ~0ULL << (start % 64);
+        } else if (i == BITMAP_WORDS) {
+            // Back at the first word: the slots before 'start' in it
+            bits &= start % 64 == 0 ? 0 : ~(~0ULL << (start % 64));
+        }
+        if (bits != 0) {
+            unsigned slot = word * 64 + __builtin_ctzll(bits);
+            return ((slot - start) & SLOT_MASK) + 1;
+        }
+    }
+    return 0;
+}
+
+// Unlink the schedules in a slot that are due by 'tick' and push them onto 'due'
+static void collect_due(unsigned slot, uint64_t tick, schedule_t **due) {
+    schedule_t *s = sched.slots[slot];
+    while (s != NULL) {
+        schedule_t *next = s->slot_next;
+        if (s->due_tick <= tick) {
+            wheel_remove(s);
+            s->slot_next = *due;
+            *due = s;
+        }
+        s = next;
+    }
+}
+
+static void start_run(schedule_t *s) {
+    // The launcher may modify the tokens, so each run gets its own copy
+    strvec_t tokens;
+    if (strvec_init(&tokens) == -1) {
+        return;
+    }
+    for (unsigned i = 0; i < s->command.length; i++) {
+        if (strvec_add(&tokens, strvec_get(&s->command, i)) == -1) {
+            strvec_clear(&tokens);
+            return;
+        }
+    }
+    s->runs++;
+    pid_t pid = sched.launch(&tokens, sched.arg);
+    strvec_clear(&tokens);
+    if (pid == -1) {
+        return;
+    }
+
+    if (sched.num_runs == sched.runs_capacity) {
+        unsigned capacity = sched.runs_capacity == 0 ? 8 : sched.runs_capacity * 2;
+        run_t *runs = realloc(sched.runs, capacity * sizeof(run_t));
+        if (runs == NULL) {
+            perror("realloc");
+            return;
+        }
+        sched.runs = runs;
+        sched.runs_capacity = capacity;
+    }
+    sched.runs[sched.num_runs].pid = pid;
+    sched.runs[sched.num_runs].schedule = s;
+    sched.num_runs++;
+    s->running++;
+}
+
+// Run a schedule that has come due and put it back on the wheel for its next run
+static void fire(schedule_t *s, uint64_t now) {
+    if (s->running == 0 || s->overlap == OVERLAP_ALLOW) {
+        start_run(s);
+    } else if (s->overlap == OVERLAP_QUEUE && !s->queued) {
+        s->queued = 1;
+    } else {
+        s->skipped++;
+    }
+
+    // Step from the last due time rather than from now, so runs don't drift. Runs that
+    // were missed while the shell was busy are skipped, keeping the same phase.
+    s->next_ns += s->interval_ns;
+    if (s->next_ns <= now) {
+        uint64_t missed = (now - s->next_ns) / s->interval_ns + 1;
+        s->next_ns += missed * s->interval_ns;
+        s->skipped += missed;
+    }
+    wheel_insert(s);
+}
+
+// Process every tick up to 'now', running the schedules that are due
+static void advance(uint64_t now) {
+    uint64_t target = now <= sched.base_ns ? 0 : (now - sched.base_ns) / SCHEDULER_TICK_NS;
+    schedule_t *due = NULL;
+    if (target - sched.current_tick > SCHEDULER_WHEEL_SLOTS) {
+        // After more than a whole turn, e.g., a long foreground job, one pass over the
+        // wheel finds everything overdue
+        for (unsigned slot = 0; slot < SCHEDULER_WHEEL_SLOTS; slot++) {
+            collect_due(slot, target, &due);
+        }
+        sched.current_tick = target;
+    } else {
+        while (sched.current_tick < target) {
+            unsigned ticks = next_occupied(sched.current_tick);
+            if (ticks == 0 || sched.current_tick + ticks > target) {
+                sched.current_tick = target;
+                break;
+            }
+            sched.current_tick += ticks;
+            collect_due(sched.current_tick & SLOT_MASK, sched.current_tick, &due);
+        }
+    }
+
+    while (due != NULL) {
+        schedule_t *s = due;
+        due = s->slot_next;
+        fire(s, now);
+    }
+}
+
+static void remove_job(pid_t pid, int status) {
+    unsigned idx = 0;
+    for (job_t *current = sched.jobs->head; current != NULL; current = current->next, idx++) {
+        if (current->pid == pid) {
+            metrics_job_done(current->start_ns, status);
+            job_list_remove(sched.jobs, idx);
+            return;
+        }
+    }
+}
+
+// Collect runs that have finished and start any queued behind them
+static void reap(void) {
+    unsigned i = 0;
+    while (i < sched.num_runs) {
+        int status;
+        pid_t pid = waitpid(sched.runs[i].pid, &status, WNOHANG);
+        if (pid == 0) {
+            i++;
+            continue;
+        } else if (pid > 0) {
+            remove_job(pid, status);
+        }
+        // Otherwise the run was already collected, e.g., by "wait-all"
+
+        schedule_t *s = sched.runs[i].schedule;
+        sched.runs[i] = sched.runs[--sched.num_runs];
+        if (--s->running == 0 && s->queued) {
+            s->queued = 0;
+            start_run(s);
+        }
+    }
+}
+
+// Set the timerfd for the next occupied slot, or sooner if runs need checking on
+static void arm_timer(void) {
+    uint64_t deadline = 0;
+    unsigned ticks = next_occupied(sched.current_tick);
+    if (ticks != 0) {
+        deadline = sched.base_ns + (sched.current_tick + ticks) * SCHEDULER_TICK_NS;
+    }
+    if (sched.num_runs > 0) {
+        uint64_t check = metrics_now() + SCHEDULER_REAP_NS;
+        if (deadline == 0 || check < deadline) {
+            deadline = check;
+        }
+    }
+
+    // A zero time disarms the timer
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    spec.it_value.tv_sec = deadline / NS_PER_SEC;
+    spec.it_value.tv_nsec = deadline % NS_PER_SEC;
+    if (timerfd_settime(sched.fd, TFD_TIMER_ABSTIME, &spec, NULL) == -1) {
+        perror("timerfd_settime");
+    }
+}
+
+int scheduler_init(job_list_t *jobs, scheduler_launch_t launch, void *arg) {
+    sched.fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (sched.fd == -1) {
+        perror("timerfd_create");
+        return -1;
+    }
+    sched.jobs = jobs;
+    sched.launch = launch;
+    sched.arg = arg;
+    sched.base_ns = metrics_now();
+    sched.next_id = 1;
+    return 0;
+}
+
+static void free_schedule(schedule_t *s) {
+    strvec_clear(&s->command);
+    free(s);
+}
+
+void scheduler_free(void) {
+    schedule_t *s = sched.head;
+    while (s != NULL) {
+        schedule_t *next = s->next;
+        free_schedule(s);
+        s = next;
+    }
+    free(sched.runs);
+    if (sched.fd != -1) {
+        close(sched.fd);
+    }
+    memset(&sched, 0, sizeof(sched));
+    sched.fd = -1;
+}
+
+int scheduler_fd(void) {
+    return sched.fd;
+}
+
+void scheduler_dispatch(void) {
+    if (sched.fd == -1) {
+        return;
+    }
+    uint64_t expirations;
+    if (read(sched.fd, &expirations, sizeof(expirations)) == -1 && errno != EAGAIN) {
+        perror("read");
+    }
+    reap();
+    advance(metrics_now());
+    arm_timer();
+}
+
+// Parse an interval such as "5s", "500ms", "1.5m", "2h", or "30" (seconds)
+// Returns 0 on success or -1 if the text is not a valid interval
+static int parse_interval(const char *text, uint64_t *ns) {
+    static const struct {
+        const char *suffix;
+        double ns;
+    } units[] = {{"", 1e9}, {"ms", 1e6}, {"s", 1e9}, {"m", 60e9}, {"h", 3600e9}};
+
+    char *end;
+    errno = 0;
+    double value = strtod(text, &end);
+    if (end == text || errno != 0 || !isfinite(value) || value <= 0) {
+        return -1;
+    }
+    for (size_t i = 0; i < sizeof(units) / sizeof(units[0]); i++) {
+        if (strcmp(end, units[i].suffix) == 0) {
+            double interval = value * units[i].ns;
+            // Keep next_ns arithmetic far from overflow: a year is plenty
+            if (interval > 365 * 24 * 3600e9) {
+                return -1;
+            }
+            *ns = (uint64_t) interval;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static void list_schedules(void) {
+    if (sched.head == NULL) {
+        return;
+    }
+    printf("%4s  %-8s  %-7s  %8s  %8s  %s\n", "ID", "EVERY", "OVERLAP", "RUNS", "SKIPPED",
+           "COMMAND");
+    for (schedule_t *s = sched.head; s != NULL; s = s->next) {
+        printf("%4u  %-8s  %-7s  %8llu  %8llu ", s->id, s->interval_text,
+               overlap_names[s->overlap], s->runs, s->skipped);
+        for (unsigned i = 0; i < s->command.length; i++) {
+            printf(" %s", strvec_get(&s->command, i));
+        }
+        printf("\n");
+    }
+}
+
+int scheduler_every(const strvec_t *tokens) {
+    if (tokens->length == 1) {
+        list_schedules();
+        return 0;
+    }
+    if (sched.fd == -1) {
+        fprintf(stderr, "every: Scheduler is not available\n");
+        return -1;
+    }
+
+    const char *interval_text = strvec_get(tokens, 1);
+    uint64_t interval_ns;
+    if (parse_interval(interval_text, &interval_ns) == -1 ||
+        strlen(interval_text) >= INTERVAL_TEXT_LEN) {
+        fprintf(stderr, "every: Invalid interval: %s\n", interval_text);
+        return -1;
+    }
+    if (interval_ns < SCHEDULER_TICK_NS) {
+        fprintf(stderr, "every: Interval must be at least %llums\n",
+                SCHEDULER_TICK_NS / 1000000);
+        return -1;
+    }
+
+    overlap_t overlap = OVERLAP_ALLOW;
+    unsigned first = 2;
+    if (first < tokens->length && strcmp(strvec_get(tokens, first), "--no-overlap") == 0) {
+        overlap = OVERLAP_SKIP;
+        first++;
+    } else if (first < tokens->length && strcmp(strvec_get(tokens, first), "--queue") == 0) {
+        overlap = OVERLAP_QUEUE;
+        first++;
+    }
+    if (first == tokens->length) {
+        fprintf(stderr, "every: Usage: every INTERVAL [--no-overlap | --queue] COMMAND [ARGS...]\n");
+        return -1;
+    }
+    // Runs start while the shell waits for input, where a builtin (cd, fg, history -c, ...)
+    // would act on the shell behind the user's back, so only programs can be scheduled
+    if (is_builtin(strvec_get(tokens, first))) {
+        fprintf(stderr, "every: Cannot schedule builtin %s\n", strvec_get(tokens, first));
+        return -1;
+    }
+
+    schedule_t *s = calloc(1, sizeof(schedule_t));
+    if (s == NULL) {
+        perror("calloc");
+        return -1;
+    }
+    if (strvec_init(&s->command) == -1) {
+        free(s);
+        return -1;
+    }
+    for (unsigned i = first; i < tokens->length; i++) {
+        if (strvec_add(&s->command, strvec_get(tokens, i)) == -1) {
+            free_schedule(s);
+            return -1;
+        }
+    }
+    strcpy(s->interval_text, interval_text);
+    s->interval_ns = interval_ns;
+    s->overlap = overlap;
+    s->id = sched.next_id++;
+
+    // Catch the wheel up first, so the new schedule is placed relative to the present
+    uint64_t now = metrics_now();
+    advance(now);
+    s->next_ns = now + interval_ns;
+    wheel_insert(s);
+    s->prev = sched.tail;
+    if (sched.tail != NULL) {
+        sched.tail->next = s;
+    } else {
+        sched.head = s;
+    }
+    sched.tail = s;
+    arm_timer();
+
+    printf("Schedule %u\n", s->id);
+    return 0;
+}
+
+int scheduler_cancel(const strvec_t *tokens) {
+    if (tokens->length != 2) {
+        fprintf(stderr, "cancel: Usage: cancel ID\n");
+        return -1;
+    }
+    const char *text = strvec_get(tokens, 1);
+    char *end;
+    unsigned long id = strtoul(text, &end, 10);
+    schedule_t *s = sched.head;
+    while (s != NULL && (*end != '\0' || end == text || s->id != id)) {
+        s = s->next;
+    }
+    if (s == NULL) {
+        fprintf(stderr, "cancel: No such schedule: %s\n", text);
+        return -1;
+    }
+
+    wheel_remove(s);
+    if (s->prev != NULL) {
+        s->prev->next = s->next;
+    } else {
+        sched.head = s->next;
+    }
+    if (s->next != NULL) {
+        s->next->prev = s->prev;
+    } else {
+        sched.tail = s->prev;
+    }
+
+    // Runs still going are no longer collected here; they stay on as ordinary jobs
+    unsigned i = 0;
+    while (i < sched.num_runs) {
+        if (sched.runs[i].schedule == s) {
+            sched.runs[i] = sched.runs[--sched.num_runs];
+        } else {
+            i++;
+        }
+    }
+    free_schedule(s);
+    arm_timer();
+    return 0;
+}
@@ -0,0 +1,83 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <sys/types.h>
+
+#include "job_list.h"
+#include "string_vector.h"
+
+// Resolution of the timer wheel, and so the shortest interval, in nanoseconds
+#define SCHEDULER_TICK_NS 10000000ULL
+// Slots in the timer wheel; a power of 2. One turn of the wheel covers about 10 seconds.
+#define SCHEDULER_WHEEL_SLOTS 1024
+// While runs are still going, the shell checks on them at least this often, in nanoseconds
+#define SCHEDULER_REAP_NS 100000000ULL
+
+/*
+ * Start one scheduled run of a command, as the shell would run "CMD &"
+ * tokens: The command's tokens, which may be modified
+ * arg: The 'arg' passed to scheduler_init()
+ * Returns the process ID of the background job started, or -1 on error
+ */
+typedef pid_t (*scheduler_launch_t)(strvec_t *tokens, void *arg);
+
+/*
+ * Set up the scheduler and its timerfd. Must be called before any other
+ * function here.
+ * jobs: The shell's job list, where scheduled runs are listed while they go
+ * launch: Called to start each scheduled run
+ * arg: Passed to 'launch'
+ * Returns 0 on success or -1 on error
+ */
+int scheduler_init(job_list_t *jobs, scheduler_launch_t launch, void *arg);
+
+/*
+ * Cancel all schedules and close the timerfd. Runs still going are left in
+ * the job list.
+ */
+void scheduler_free(void);
+
+/*
+ * Get the file descriptor that becomes readable when scheduler_dispatch()
+ * has work to do. It is the same for the life of the shell, however many
+ * schedules there are.
+ * Returns the descriptor, or -1 if scheduler_init() failed
+ */
+int scheduler_fd(void);
+
+/*
+ * Start every run that has come due, collect finished runs (removing them from
+ * the job list), and set the timer for the next thing to do. Each schedule due
+ * costs constant time; empty stretches of the wheel are skipped with a bitmap.
+ */
+void scheduler_dispatch(void);
+
+/*
+ * The "every" builtin: every [INTERVAL [--no-overlap | --queue] COMMAND [ARGS...]]
+ * Runs COMMAND every INTERVAL (e.g., "5s", "500ms", "2m", "1h", or a number
+ * of seconds), starting one interval from now, until the schedule is
+ * cancelled. Runs are started as background jobs while the shell waits for
+ * input, so they appear in "jobs". Run times are kept to multiples of the
+ * interval from the start; runs missed while the shell was busy are skipped,
+ * not made up. If the previous run is still going when the next is due,
+ * another is started anyway, unless --no-overlap skips the run or --queue
+ * starts it as soon as the previous run finishes (at most one waits).
+ * The arguments are expanded once, when the schedule is made. COMMAND must
+ * be a program, not a builtin. With no arguments, lists the schedules.
+ * tokens: Tokens typed by the user, e.g., "every 5s --no-overlap make"
+ * Returns 0 on success or -1 on error
+ */
+int scheduler_every(const strvec_t *tokens);
+
+/*
+ * The "cancel" builtin: cancel ID
+ * Removes a schedule made by "every". A run still going continues as an
+ * ordinary background job.
+ * tokens: Tokens typed by the user, e.g., "cancel 2"
+ * Returns 0 on success or -1 on error
+ */
+int scheduler_cancel(const strvec_t *tokens);
+
+#endif    // SCHEDULER_H
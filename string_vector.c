@@ -6,12 +6,26 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "allocator.h"
+
 #define INITIAL_SIZE 4
 
+static char *copy_string(const char *s) {
+    char *copy = mem_alloc(MEM_STRINGS, strlen(s) + 1);
+    if (copy != NULL) {
+        strcpy(copy, s);
+    }
+    return copy;
+}
+
+static void free_string(char *s) {
+    mem_free(MEM_STRINGS, s, strlen(s) + 1);
+}
+
 int strvec_init(strvec_t *vec) {
     vec->length = 0;
     vec->capacity = INITIAL_SIZE;
-    vec->data = malloc(INITIAL_SIZE * sizeof(char *));
+    vec->data = mem_alloc(MEM_STRINGS, INITIAL_SIZE * sizeof(char *));
     if (vec->data == NULL) {
         return -1;
     }
@@ -24,9 +38,9 @@ void strvec_clear(strvec_t *vec) {
         return;
     }
     for (int i = 0; i < vec->length; i++) {
-        free(vec->data[i]);
+        free_string(vec->data[i]);
     }
-    free(vec->data);
+    mem_free(MEM_STRINGS, vec->data, vec->capacity * sizeof(char *));
 
     vec->length = 0;
     vec->capacity = 0;
@@ -42,7 +56,8 @@ int strvec_add(strvec_t *vec, const char *s) {
 
     if (vec->length == vec->capacity) {
         // Expand underlying array
-        char **new_data = realloc(vec->data, 2 * vec->capacity * sizeof(char *));
+        char **new_data = mem_realloc(MEM_STRINGS, vec->data, vec->capacity * sizeof(char *),
+                                      2 * vec->capacity * sizeof(char *));
         if (new_data == NULL) {
             return -1;
         } else {
@@ -51,10 +66,9 @@ int strvec_add(strvec_t *vec, const char *s) {
         vec->capacity = vec->capacity * 2;
     }
 
-    if ((vec->data[vec->length] = malloc((strlen(s) + 1) * sizeof(char))) == NULL) {
+    if ((vec->data[vec->length] = copy_string(s)) == NULL) {
         return -1;
     }
-    strcpy(vec->data[vec->length], s);
     vec->length++;
     return 0;
 }
@@ -67,6 +81,20 @@ char *strvec_get(const strvec_t *vec, unsigned i) {
     return vec->data[i];
 }
 
+int strvec_set(strvec_t *vec, unsigned i, const char *s) {
+    if (i >= vec->length) {
+        return -1;
+    }
+
+    char *copy = copy_string(s);
+    if (copy == NULL) {
+        return -1;
+    }
+    free_string(vec->data[i]);
+    vec->data[i] = copy;
+    return 0;
+}
+
 int strvec_find(const strvec_t *vec, const char *s) {
     for (int i = 0; i < vec->length; i++) {
         if (strcmp(vec->data[i], s) == 0) {
@@ -82,7 +110,7 @@ void strvec_take(strvec_t *vec, unsigned n) {
     }
 
     for (int i = n; i < vec->length; i++) {
-        free(vec->data[i]);
+        free_string(vec->data[i]);
     }
     vec->length = n;
 }
@@ -42,6 +42,16 @@ int strvec_add(strvec_t *vec, const char *s);
  */
 char *strvec_get(const strvec_t *vec, unsigned i);
 
+/*
+ * Replace an existing element of a string vector
+ * vec: Pointer to the vector to modify
+ * i: Index of element to replace (starts at 0)
+ * s: The new string
+ * Returns 0 on success, -1 on error
+ * Note: The vector stores its own copy of this string
+ */
+int strvec_set(strvec_t *vec, unsigned i, const char *s);
+
 /*
  * Search for a specific string within a string vector
  * vec: Pointer to the vector to search within
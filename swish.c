@@ -1,108 +1,115 @@
 #define _GNU_SOURCE
 
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
 #include <signal.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include "allocator.h"
+#include "completion.h"
+#include "copy.h"
+#include "coproc.h"
+#include "history.h"
 #include "job_list.h"
+#include "job_monitor.h"
+#include "line_editor.h"
+#include "metrics.h"
+#include "scheduler.h"
 #include "string_vector.h"
 #include "swish_funcs.h"
+#include "variables.h"
+#include "wildcard.h"
+#include "xargs.h"
 
 #define CMD_LEN 512
 #define PROMPT "@> "
+#define SHELL_EXIT -1
 
-int main(int argc, char **argv) {
-    // Set up shell to ignore SIGTTIN, SIGTTOU when put in background
-    // You should adapt this code for use in run_command().
-    struct sigaction sac;
-    sac.sa_handler = SIG_IGN;
-    if (sigfillset(&sac.sa_mask) == -1) {
-        perror("sigfillset");
-        return 1;
-    }
-
-    sac.sa_flags = 0;
-
-    if (sigaction(SIGTTIN, &sac, NULL) == -1 || sigaction(SIGTTOU, &sac, NULL) == -1) {
-        perror("sigaction");
-        return 1;
-    }
-
-    strvec_t tokens;
-    strvec_init(&tokens);
-    job_list_t jobs;
-    job_list_init(&jobs);
-    char cmd[CMD_LEN];
-
-    printf("%s", PROMPT);
-    while (fgets(cmd, CMD_LEN, stdin) != NULL) {
-        // Need to remove trailing '\n' from cmd. There are fancier ways.
-        int i = 0;
-        while (cmd[i] != '\n') {
-            i++;
-        }
-        cmd[i] = '\0';
+// Run a single command, either a builtin or a program, from a command list
+// tokens: The command's tokens, without any list operators
+// is_background: 1 if the command was followed by "&"
+// Returns the command's exit status, or SHELL_EXIT if the command was "exit"
+static int run_list_command(strvec_t *tokens, int is_background, job_list_t *jobs,
+                            coproc_list_t *coprocs) {
+    metrics_count(METRIC_COMMANDS);
+    int exit_status = 0;
+    const char *first_token = strvec_get(tokens, 0);
 
-        if (tokenize(cmd, &tokens) != 0) {
-            printf("Failed to parse command\n");
-            strvec_clear(&tokens);
-            job_list_free(&jobs);
-            return 1;
-        }
-
-        if (tokens.length == 0) {
-            printf("%s", PROMPT);
-            continue;
+    if (strcmp(first_token, "pwd") == 0) {
+        // Print the shell's current working directory
+        char cwd[PATH_MAX];
+        if (getcwd(cwd, sizeof(cwd)) != NULL) {
+            printf("%s\n", cwd);
+        } else {
+            perror("getcwd");
+            exit_status = 1;
         }
+    }
 
-        const char *first_token = strvec_get(&tokens, 0);
-
-        if (strcmp(first_token, "pwd") == 0) {
-            // Print the shell's current working directory
-            if (getcwd(cmd, sizeof(cmd)) != NULL) {
-                printf("%s\n", cmd);
-            } else {
-                perror("getcwd");
-            }
+    else if (strcmp(first_token, "cd") == 0) {
+        // Change the shell's current working directory
+        const char *second_token = strvec_get(tokens, 1);
+        if (strvec_get(tokens, 1) == NULL) {
+            perror("strvec_get");
         }
 
-        else if (strcmp(first_token, "cd") == 0) {
-            // Change the shell's current working directory
-            const char *second_token = strvec_get(&tokens, 1);
-            if (strvec_get(&tokens, 1) == NULL) {
-                perror("strvec_get");
+        if (second_token != NULL) {
+            if (chdir(second_token) != 0) {
+                perror("chdir");
+                exit_status = 1;
             }
-
-            if (second_token != NULL) {
-                if (chdir(second_token) != 0) {
-                    perror("chdir");
-                }
-            } else {
-                char *home = getenv("HOME");
-                if (!home) {
-                    fprintf(stderr, "HOME environment variable not set\n");
-                } else if (chdir(home) != 0) {
-                    perror("chdir");
-                }
+        } else {
+            const char *home = vars_get("HOME");
+            if (!home) {
+                fprintf(stderr, "HOME environment variable not set\n");
+                exit_status = 1;
+            } else if (chdir(home) != 0) {
+                perror("chdir");
+                exit_status = 1;
             }
         }
+    }
 
-        else if (strcmp(first_token, "exit") == 0) {
-            strvec_clear(&tokens);
-            break;
-        }
+    else if (strcmp(first_token, "exit") == 0) {
+        exit_status = SHELL_EXIT;
+    }
 
-        // Print out current list of pending jobs
-        else if (strcmp(first_token, "jobs") == 0) {
+    // Print out current list of pending jobs
+    else if (strcmp(first_token, "jobs") == 0) {
+        const char *option = strvec_get(tokens, 1);
+        if (option != NULL && strcmp(option, "--watch") == 0) {
+            // "jobs --watch [interval]" shows a live table until a key is pressed
+            double interval = JOB_MONITOR_DEFAULT_INTERVAL;
+            const char *text = strvec_get(tokens, 2);
+            char *end = "";
+            errno = 0;
+            if (text != NULL) {
+                interval = strtod(text, &end);
+            }
+            if ((text != NULL && end == text) || *end != '\0' || errno != 0 ||
+                !isfinite(interval) || interval < JOB_MONITOR_MIN_INTERVAL ||
+                interval > JOB_MONITOR_MAX_INTERVAL) {
+                printf("Invalid refresh interval\n");
+                exit_status = 1;
+            } else if (job_monitor_run(jobs, interval) == -1) {
+                printf("Failed to watch jobs\n");
+                exit_status = 1;
+            }
+        } else {
             int i = 0;
-            job_t *current = jobs.head;
+            job_t *current = jobs->head;
             while (current != NULL) {
                 char *status_desc;
                 if (current->status == BACKGROUND) {
                     status_desc = "background";
+                } else if (current->status == COPROC) {
+                    status_desc = "coproc";
                 } else {
                     status_desc = "stopped";
                 }
@@ -111,117 +118,469 @@ int main(int argc, char **argv) {
                 current = current->next;
             }
         }
+    }
 
-        // Move stopped job into foreground
-        else if (strcmp(first_token, "fg") == 0) {
-            if (resume_job(&tokens, &jobs, 1) == -1) {
-                printf("Failed to resume job in foreground\n");
-            }
+    // Move stopped job into foreground
+    else if (strcmp(first_token, "fg") == 0) {
+        if (resume_job(tokens, jobs, 1) == -1) {
+            printf("Failed to resume job in foreground\n");
+            exit_status = 1;
+        }
+    }
+
+    // Move stopped job into background
+    else if (strcmp(first_token, "bg") == 0) {
+        if (resume_job(tokens, jobs, 0) == -1) {
+            printf("Failed to resume job in background\n");
+            exit_status = 1;
+        }
+    }
+
+    // Wait for a specific job identified by its index in job list
+    else if (strcmp(first_token, "wait-for") == 0) {
+        if (await_background_job(tokens, jobs) == -1) {
+            printf("Failed to wait for background job\n");
+            exit_status = 1;
+        }
+    }
+
+    // Wait for all background jobs
+    else if (strcmp(first_token, "wait-all") == 0) {
+        if (await_all_background_jobs(jobs) == -1) {
+            printf("Failed to wait for all background jobs\n");
+            exit_status = 1;
         }
+    }
 
-        // Move stopped job into background
-        else if (strcmp(first_token, "bg") == 0) {
-            if (resume_job(&tokens, &jobs, 0) == -1) {
-                printf("Failed to resume job in background\n");
+    // Export variables: "export NAME=value" or "export NAME"
+    else if (strcmp(first_token, "export") == 0) {
+        if (tokens->length == 1) {
+            vars_print(1);
+        }
+        for (int j = 1; j < tokens->length; j++) {
+            const char *arg = strvec_get(tokens, j);
+            int result = strchr(arg, '=') != NULL ? vars_assign(arg, 1) : vars_export(arg);
+            if (result == -1) {
+                printf("Failed to export %s\n", arg);
+                exit_status = 1;
             }
         }
+    }
 
-        // Wait for a specific job identified by its index in job list
-        else if (strcmp(first_token, "wait-for") == 0) {
-            if (await_background_job(&tokens, &jobs) == -1) {
-                printf("Failed to wait for background job\n");
+    // Set shell variables that are not exported: "set NAME=value"
+    else if (strcmp(first_token, "set") == 0) {
+        if (tokens->length == 1) {
+            vars_print(0);
+        }
+        for (int j = 1; j < tokens->length; j++) {
+            if (vars_assign(strvec_get(tokens, j), 0) == -1) {
+                printf("Failed to set %s\n", strvec_get(tokens, j));
+                exit_status = 1;
             }
         }
+    }
+
+    // Remove variables
+    else if (strcmp(first_token, "unset") == 0) {
+        for (int j = 1; j < tokens->length; j++) {
+            vars_unset(strvec_get(tokens, j));
+        }
+    }
+
+    // Copy or concatenate files without starting a process per file
+    else if (strcmp(first_token, "copy") == 0) {
+        if (copy_command(tokens) == -1) {
+            printf("Failed to copy files\n");
+            exit_status = 1;
+        }
+    }
+
+    // Print or export the shell's metrics
+    else if (strcmp(first_token, "stats") == 0) {
+        if (metrics_command(tokens) == -1) {
+            printf("Failed to report stats\n");
+            exit_status = 1;
+        }
+    }
 
-        // Wait for all background jobs
-        else if (strcmp(first_token, "wait-all") == 0) {
-            if (await_all_background_jobs(&jobs) == -1) {
-                printf("Failed to wait for all background jobs\n");
+    // Report the memory used by the shell's own data structures
+    else if (strcmp(first_token, "memstats") == 0) {
+        if (mem_command(tokens) == -1) {
+            printf("Failed to report memory usage\n");
+            exit_status = 1;
+        }
+    }
+
+    // Run a command on batches of items read from stdin or a file
+    else if (strcmp(first_token, "xargs") == 0) {
+        int status = xargs_command(tokens, jobs);
+        if (status == -1) {
+            printf("Failed to run xargs\n");
+            exit_status = 1;
+        } else {
+            exit_status = status;
+        }
+    }
+
+    // List, search, or clear the command history
+    else if (strcmp(first_token, "history") == 0) {
+        if (history_command(tokens) == -1) {
+            printf("Failed to access history\n");
+            exit_status = 1;
+        }
+    }
+
+    // Run a command at a fixed interval, or list the schedules
+    else if (strcmp(first_token, "every") == 0) {
+        if (scheduler_every(tokens) == -1) {
+            printf("Failed to schedule command\n");
+            exit_status = 1;
+        }
+    }
+
+    // Stop running a scheduled command
+    else if (strcmp(first_token, "cancel") == 0) {
+        if (scheduler_cancel(tokens) == -1) {
+            printf("Failed to cancel schedule\n");
+            exit_status = 1;
+        }
+    }
+
+    // Start a named coprocess connected to the shell
+    else if (strcmp(first_token, "coproc") == 0) {
+        if (coproc_start(coprocs, jobs, tokens) == -1) {
+            printf("Failed to start coprocess\n");
+            exit_status = 1;
+        }
+    }
+
+    // Send a line of text to a coprocess
+    else if (strcmp(first_token, "send") == 0) {
+        coproc_t *coproc = NULL;
+        if (tokens->length >= 2) {
+            coproc = coproc_find(coprocs, strvec_get(tokens, 1));
+        }
+
+        if (coproc == NULL) {
+            printf("No such coprocess\n");
+            exit_status = 1;
+        } else {
+            // Rejoin the remaining tokens, which may have grown past a line of input through
+            // variable and wildcard expansion
+            size_t text_len = 1;
+            for (int j = 2; j < tokens->length; j++) {
+                text_len += strlen(strvec_get(tokens, j)) + 1;
+            }
+            char *text = malloc(text_len);
+            if (text == NULL) {
+                perror("malloc");
+                return 1;
+            }
+            char *end = text;
+            *end = '\0';
+            for (int j = 2; j < tokens->length; j++) {
+                end = stpcpy(end, strvec_get(tokens, j));
+                if (j < tokens->length - 1) {
+                    end = stpcpy(end, " ");
+                }
             }
+            if (coproc_send(coproc, text) == -1) {
+                printf("Failed to send to coprocess\n");
+                exit_status = 1;
+            }
+            free(text);
+        }
+    }
+
+    // Print the next line of output from a coprocess
+    else if (strcmp(first_token, "recv") == 0) {
+        coproc_t *coproc = NULL;
+        if (tokens->length >= 2) {
+            coproc = coproc_find(coprocs, strvec_get(tokens, 1));
+        }
+
+        char *line;
+        if (coproc == NULL) {
+            printf("No such coprocess\n");
+            exit_status = 1;
+        } else if (coproc_recv(coproc, &line) == 0) {
+            printf("%s\n", line);
+            free(line);
+        } else {
+            // The coprocess has finished; clean up after it
+            printf("Coprocess %s has exited\n", coproc->name);
+            coproc_remove(coprocs, jobs, coproc);
+            exit_status = 1;
         }
+    }
 
-        else {
-            // If the last token input by the user is "&", start the current
-            // command in the background.
-            int is_background = 0;
-            if (strvec_get(&tokens, tokens.length - 1) == NULL) {
-                perror("strvec_get");
+    else {
+        // "cmd |& NAME" connects the command's output to coprocess NAME
+        int coproc_fd = -1;
+        int coproc_index = strvec_find(tokens, "|&");
+        if (coproc_index != -1) {
+            coproc_t *coproc = NULL;
+            if (coproc_index == tokens->length - 2) {
+                coproc = coproc_find(coprocs, strvec_get(tokens, coproc_index + 1));
             }
-            if (tokens.length > 0 && strcmp(strvec_get(&tokens, tokens.length - 1), "&") == 0) {
-                is_background = 1;
-                // Remove "&" from tokens
-                strvec_take(&tokens, tokens.length - 1);
+            if (coproc == NULL) {
+                printf("No such coprocess\n");
+                return 1;
             }
+            coproc_fd = coproc->fd;
+            strvec_take(tokens, coproc_index);
+        }
 
-            // If the user input does not match any built-in shell command,
-            // treat the input as a program name and command-line arguments
-            pid_t child_pid = fork();
-            if (child_pid == -1) {
-                perror("fork");
-            } else if (child_pid == 0) {
-                // Child Process
-                if (is_background) {
-                    // Set child process in its own process group
-                    if (setpgid(0, 0) == -1) {
-                        perror("setpgid");
-                    }
+        // Turn any "<(cmd)" or ">(cmd)" arguments into pipes before forking
+        procsub_list_t subs;
+        if (procsub_prepare(tokens, &subs) == -1) {
+            printf("Failed to set up process substitution\n");
+            return 1;
+        }
+
+        // If the user input does not match any built-in shell command,
+        // treat the input as a program name and command-line arguments
+        metrics_count(METRIC_EXTERNAL);
+        uint64_t job_start = metrics_now();
+        // A foreground job reports a failed exec through a pipe, for "stats"
+        int exec_report[2] = {-1, -1};
+        if (!is_background && exec_report_open(exec_report) == -1) {
+            perror("pipe2");
+        }
+
+        pid_t child_pid = fork();
+        if (child_pid == -1) {
+            perror("fork");
+            metrics_count(METRIC_FORK_FAILURES);
+            procsub_release(&subs, 0);
+            if (exec_report[0] != -1) {
+                close(exec_report[0]);
+                close(exec_report[1]);
+            }
+            exit_status = 1;
+        } else if (child_pid == 0) {
+            // Child Process
+            procsub_release(&subs, 1);
+            exec_report_child(exec_report);
+            if (coproc_fd != -1 && dup2(coproc_fd, STDOUT_FILENO) == -1) {
+                perror("dup2");
+                exit(EXIT_FAILURE);
+            }
+            if (is_background) {
+                // Set child process in its own process group
+                if (setpgid(0, 0) == -1) {
+                    perror("setpgid");
                 }
+            }
+
+            // Ensure the child terminates on failure
+            if (run_command(tokens) == -1) {
+                exit(EXIT_FAILURE);
+            }
+        } else {
+            // Parent Process
+            metrics_record(METRIC_SPAWN_LATENCY, metrics_now() - job_start);
+            if (exec_report[1] != -1) {
+                close(exec_report[1]);
+            }
+
+            // Ensure the child process runs in its own process group. The child does this
+            // too, and the call fails with EACCES once the child has already exec()'d.
+            if (setpgid(child_pid, child_pid) == -1 && errno != EACCES) {
+                perror("setpgid");
+            }
+
+            // Run process substitutions alongside the command, in its process group
+            procsub_spawn(&subs, child_pid);
+            procsub_release(&subs, 0);
 
-                // Ensure the child terminates on failure
-                if (run_command(&tokens) == -1) {
-                    exit(EXIT_FAILURE);
+            if (is_background) {
+                // Add background job to job list and do NOT wait for it
+                if (job_list_add(jobs, child_pid, tokens->data[0], BACKGROUND) == -1) {
+                    perror("job_list_add");
                 }
             } else {
-                // Parent Process
-                // Ensure the child process runs in its own process group
-                if (setpgid(child_pid, child_pid) == -1) {
-                    perror("setpgid");
+                // Foreground execution
+                // Set the child process as the foreground process group
+                if (tcsetpgrp(STDIN_FILENO, child_pid) == -1) {
+                    perror("tcsetpgrp");
                 }
 
-                if (is_background) {
-                    // Add background job to job list and do NOT wait for it
-                    if (job_list_add(&jobs, child_pid, tokens.data[0], BACKGROUND) == -1) {
-                        perror("job_list_add");
-                    }
+                // Handle the issue of foreground/background terminal process
+                // groups.
+                // Wait for child to finish
+                int status;
+                int waited = wait_for_job(child_pid, &status);
+                if (exec_report_check(exec_report[0]) && waited == 0) {
+                    metrics_count(METRIC_EXEC_FAILURES);
+                }
+                if (waited == -1) {
+                    // 'status' was never set, so there is nothing to record
+                    perror("waitpid");
+                    exit_status = 1;
                 } else {
-                    // Foreground execution
-                    // Set the child process as the foreground process group
-                    if (tcsetpgrp(STDIN_FILENO, child_pid) == -1) {
+                    metrics_job_done(job_start, status);
+                    exit_status = job_exit_status(status);
+                }
+
+                // If the child was stopped, reset the shell as foreground process
+                if (waited == 0 && WIFSTOPPED(status)) {
+                    if (tcsetpgrp(STDIN_FILENO, getpid()) == -1) {
                         perror("tcsetpgrp");
                     }
 
-                    // Handle the issue of foreground/background terminal process
-                    // groups.
-                    // Wait for child to finish
-                    int status;
-                    if (waitpid(child_pid, &status, WUNTRACED) == -1) {
-                        perror("waitpid");
+                    // Add the stopped job to the job list
+                    if (job_list_add(jobs, child_pid, tokens->data[0], STOPPED) == -1) {
+                        perror("job_list_add");
+                    } else {
+                        // The job started before it was stopped and added to the list
+                        job_list_get(jobs, jobs->length - 1)->start_ns = job_start;
                     }
+                }
 
-                    // If the child was stopped, reset the shell as foreground process
-                    if (WIFSTOPPED(status)) {
-                        if (tcsetpgrp(STDIN_FILENO, getpid()) == -1) {
-                            perror("tcsetpgrp");
-                        }
+                // Restore the shell itself as the foreground process group
+                if (tcsetpgrp(STDIN_FILENO, getpid()) == -1) {
+                    perror("tcsetpgrp");
+                }
+            }
+        }
+    }
 
-                        // Add the stopped job to the job list
-                        if (job_list_add(&jobs, child_pid, tokens.data[0], STOPPED) == -1) {
-                            perror("job_list_add");
-                        }
-                    }
+    return exit_status;
+}
 
-                    // Restore the shell itself as the foreground process group
-                    if (tcsetpgrp(STDIN_FILENO, getpid()) == -1) {
-                        perror("tcsetpgrp");
-                    }
+// The shell's state that scheduled runs need
+typedef struct {
+    job_list_t *jobs;
+    coproc_list_t *coprocs;
+} shell_state_t;
+
+// Start a scheduled run of a command, as if "CMD &" had been typed
+// Returns the pid of the job started, or -1 on error
+static pid_t launch_scheduled(strvec_t *tokens, void *arg) {
+    shell_state_t *shell = arg;
+    unsigned num_jobs = shell->jobs->length;
+    run_list_command(tokens, 1, shell->jobs, shell->coprocs);
+    if (shell->jobs->length > num_jobs) {
+        // New jobs go at the end of the list
+        return job_list_get(shell->jobs, shell->jobs->length - 1)->pid;
+    }
+    return -1;
+}
+
+int main(int argc, char **argv) {
+    // Set up shell to ignore SIGTTIN, SIGTTOU when put in background
+    // You should adapt this code for use in run_command().
+    struct sigaction sac;
+    sac.sa_handler = SIG_IGN;
+    if (sigfillset(&sac.sa_mask) == -1) {
+        perror("sigfillset");
+        return 1;
+    }
+
+    sac.sa_flags = 0;
+
+    if (sigaction(SIGTTIN, &sac, NULL) == -1 || sigaction(SIGTTOU, &sac, NULL) == -1) {
+        perror("sigaction");
+        return 1;
+    }
+
+    if (mem_init() == -1 || vars_init(environ) == -1) {
+        return 1;
+    }
+    // The shell still runs without saved history if the history file can't be used
+    history_init();
+
+    strvec_t tokens;
+    strvec_init(&tokens);
+    job_list_t jobs;
+    job_list_init(&jobs);
+    coproc_list_t coprocs;
+    coproc_list_init(&coprocs);
+    // Completion falls back to indexing PATH on first use if the background build can't start
+    completion_init(&jobs);
+    // The shell still runs, without "every", if the scheduler can't be set up
+    shell_state_t shell = {&jobs, &coprocs};
+    if (scheduler_init(&jobs, launch_scheduled, &shell) == 0) {
+        line_editor_watch(scheduler_fd(), scheduler_dispatch);
+    }
+    char cmd[CMD_LEN];
+
+    while (line_editor_read(PROMPT, cmd, CMD_LEN) != -1) {
+        // Collect process substitutions that outlived the commands they were started for
+        procsub_reap();
+        history_add(cmd);
+        // Pressing Enter at an empty prompt is common with line editing; split_words() rejects it
+        if (cmd[strspn(cmd, " ")] == '\0') {
+            continue;
+        }
+
+        if (split_words(cmd, &tokens) != 0) {
+            printf("Failed to parse command\n");
+            strvec_clear(&tokens);
+            scheduler_free();
+            coproc_list_free(&coprocs);
+            job_list_free(&jobs);
+            return 1;
+        }
+
+        if (tokens.length == 0) {
+            continue;
+        }
+
+        // Run each command of the line in turn, skipping those whose "&&" or "||"
+        // condition is not met by the exit status of the last command run. Each command
+        // is expanded just before it runs, so it sees the variables and files left by
+        // the commands before it.
+        command_list_t list;
+        int exit_requested = 0;
+        if (command_list_parse(&tokens, &list) == -1) {
+            printf("Failed to parse command\n");
+        } else {
+            int exit_status = 0;
+            for (unsigned j = 0; j < list.length && !exit_requested; j++) {
+                list_item_t *item = &list.items[j];
+                if ((item->connector == LIST_AND && exit_status != 0) ||
+                    (item->connector == LIST_OR && exit_status == 0)) {
+                    continue;
+                }
+                strvec_t expanded;
+                if (strvec_init(&expanded) == -1) {
+                    break;
+                }
+                int result;
+                if (expand_words(&item->tokens, &expanded) == -1) {
+                    printf("Failed to parse command\n");
+                    result = 1;
+                } else if (expanded.length == 0) {
+                    // E.g., a command that is only an unset variable
+                    result = 0;
+                } else {
+                    result = run_list_command(&expanded, item->is_background, &jobs, &coprocs);
+                }
+                strvec_clear(&expanded);
+                if (result == SHELL_EXIT) {
+                    exit_requested = 1;
+                } else {
+                    exit_status = result;
                 }
             }
+            command_list_free(&list);
         }
 
         strvec_clear(&tokens);
-        printf("%s", PROMPT);
+        if (exit_requested) {
+            break;
+        }
     }
 
+    scheduler_free();
+    coproc_list_free(&coprocs);
     job_list_free(&jobs);
+    completion_free();
+    wildcard_cache_free();
+    history_free();
+    vars_free();
+    mem_cleanup();
     return 0;
 }
@@ -3,7 +3,10 @@
 #include "swish_funcs.h"
 
 #include <assert.h>
+#include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -11,15 +14,55 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "filters.h"
 #include "job_list.h"
+#include "metrics.h"
+#include "ring_buffer.h"
 #include "string_vector.h"
+#include "variables.h"
+#include "wildcard.h"
 
-#define MAX_ARGS 10
+#define RING_CAPACITY (1 << 16)
+// Longest ^Z waits for a pipeline's external stages to stop before stopping the pipeline
+#define PIPELINE_STOP_WAIT_MS 200
 
-// Tokenize string s
-int tokenize(char *s, strvec_t *tokens) {
+// A builtin filter stage of a pipeline, run as a thread in the pipeline process
+typedef struct {
+    filter_t filter;
+    filter_stream_t in;
+    filter_stream_t out;
+    int status;
+    pthread_t thread;
+} filter_stage_t;
+
+// The connection between two adjacent pipeline stages
+typedef struct {
+    ring_buffer_t ring;    // Used when both stages are builtin filters
+    int is_ring;
+    int fds[2];
+} pipeline_link_t;
+
+// Net number of open parentheses in a word
+static int paren_depth(const char *word) {
+    int depth = 0;
+    for (; *word != '\0'; word++) {
+        if (*word == '(') {
+            depth++;
+        } else if (*word == ')') {
+            depth--;
+        }
+    }
+    return depth;
+}
+
+static int is_procsub_word(const char *word) {
+    return (word[0] == '<' || word[0] == '>') && word[1] == '(';
+}
+
+int split_words(char *s, strvec_t *words) {
     //  Assume each token is separated by a single space (" ")
     //  Use the strtok() function to accomplish this
     char *word = strtok(s, " ");
@@ -30,14 +73,35 @@ int tokenize(char *s, strvec_t *tokens) {
         return -1;
     }
 
-    // Add each token to the 'tokens' parameter (a string vector)
+    // Add each word to the 'words' parameter (a string vector)
     while (word != NULL) {
-        if (strvec_add(tokens, word) == -1) {
+        // Keep a process substitution such as "<(sort a.txt)" together as one word
+        // by putting back the spaces strtok() replaced, up to the closing ')'
+        int is_procsub = is_procsub_word(word);
+        if (is_procsub) {
+            int depth = paren_depth(word);
+            char *end = word + strlen(word);
+            char *next;
+            while (depth > 0 && (next = strtok(NULL, " ")) != NULL) {
+                *end = ' ';
+                depth += paren_depth(next);
+                end = next + strlen(next);
+            }
+        }
+
+        // A ';' at the end of a word, as in "cd src; make", is a word of its own
+        size_t word_len = strlen(word);
+        int ends_command = 0;
+        if (!is_procsub && word_len > 1 && word[word_len - 1] == ';' &&
+            word[word_len - 2] != '\\') {
+            word[word_len - 1] = '\0';
+            ends_command = 1;
+        }
+
+        if (strvec_add(words, word) == -1 || (ends_command && strvec_add(words, ";") == -1)) {
             perror("failure to tokenize: strvec_add");
-            // Return -1 on error
             return -1;
         }
-
         word = strtok(NULL, " ");
     }
 
@@ -45,17 +109,296 @@ int tokenize(char *s, strvec_t *tokens) {
     return 0;
 }
 
-// Execute the specified program (token 0) with the specified command-line arguments and perform
-// output redirection before exec()'ing THIS FUNCTION SHOULD BE CALLED FROM A CHILD OF THE MAIN
-// SHELL PROCESS
-int run_command(strvec_t *tokens) {
-    // No command entered, return error
-    if (tokens->length == 0) {
+int expand_words(const strvec_t *words, strvec_t *tokens) {
+    for (unsigned i = 0; i < words->length; i++) {
+        char *word = strvec_get(words, i);
+        // The inner command of a process substitution is expanded when it is tokenized itself
+        int is_procsub = is_procsub_word(word);
+
+        // Substitute variables first, so that their values can contain wildcards
+        char *expanded = NULL;
+        if (!is_procsub && strchr(word, '$') != NULL) {
+            if ((expanded = vars_expand(word)) == NULL) {
+                return -1;
+            }
+            word = expanded;
+        }
+
+        // Replace a wildcard pattern with the paths it matches, or keep it as-is if it
+        // matches nothing
+        int num_matches = 0;
+        if (!is_procsub && wildcard_is_pattern(word)) {
+            if ((num_matches = wildcard_expand(word, tokens)) == -1) {
+                perror("failure to tokenize: wildcard_expand");
+                free(expanded);
+                return -1;
+            }
+        }
+
+        // A word that expands to nothing, such as an unset variable, is dropped
+        if (num_matches == 0 && word[0] != '\0' && strvec_add(tokens, word) == -1) {
+            perror("failure to tokenize: strvec_add");
+            free(expanded);
+            return -1;
+        }
+        free(expanded);
+    }
+    return 0;
+}
+
+// Tokenize string s
+int tokenize(char *s, strvec_t *tokens) {
+    strvec_t words;
+    if (strvec_init(&words) == -1) {
+        return -1;
+    }
+    int status = split_words(s, &words);
+    if (status == 0) {
+        status = expand_words(&words, tokens);
+    }
+    strvec_clear(&words);
+    return status;
+}
+
+static int is_list_operator(const char *token) {
+    return strcmp(token, ";") == 0 || strcmp(token, "&") == 0 || strcmp(token, "&&") == 0 ||
+           strcmp(token, "||") == 0;
+}
+
+static int command_list_append(command_list_t *list, strvec_t *tokens, list_connector_t connector,
+                               int is_background) {
+    list_item_t *items = realloc(list->items, (list->length + 1) * sizeof(list_item_t));
+    if (items == NULL) {
+        perror("realloc");
         return -1;
     }
+    list->items = items;
+    list->items[list->length].tokens = *tokens;
+    list->items[list->length].connector = connector;
+    list->items[list->length].is_background = is_background;
+    list->length++;
+    return 0;
+}
+
+int command_list_parse(const strvec_t *tokens, command_list_t *list) {
+    list->items = NULL;
+    list->length = 0;
+
+    list_connector_t connector = LIST_ALWAYS;
+    strvec_t current;
+    if (strvec_init(&current) == -1) {
+        perror("strvec_init");
+        return -1;
+    }
+    for (int i = 0; i < tokens->length; i++) {
+        const char *token = tokens->data[i];
+        if (!is_list_operator(token)) {
+            if (strvec_add(&current, token) == -1) {
+                perror("strvec_add");
+                goto error;
+            }
+            continue;
+        }
+
+        if (current.length == 0) {
+            fprintf(stderr, "Syntax error near '%s'\n", token);
+            goto error;
+        }
+        if (command_list_append(list, &current, connector, strcmp(token, "&") == 0) == -1) {
+            goto error;
+        }
+        if (strcmp(token, "&&") == 0) {
+            connector = LIST_AND;
+        } else if (strcmp(token, "||") == 0) {
+            connector = LIST_OR;
+        } else {
+            connector = LIST_ALWAYS;
+        }
+        if (strvec_init(&current) == -1) {
+            perror("strvec_init");
+            command_list_free(list);
+            return -1;
+        }
+    }
+
+    if (current.length > 0) {
+        if (command_list_append(list, &current, connector, 0) == -1) {
+            goto error;
+        }
+    } else {
+        strvec_clear(&current);
+        if (connector != LIST_ALWAYS) {
+            fprintf(stderr, "Syntax error: command expected after '%s'\n",
+                    connector == LIST_AND ? "&&" : "||");
+            command_list_free(list);
+            return -1;
+        }
+    }
+    return 0;
+
+error:
+    strvec_clear(&current);
+    command_list_free(list);
+    return -1;
+}
 
-    // Build a string array from the 'tokens' vector and pass this into execvp()
-    char *args[MAX_ARGS];
+void command_list_free(command_list_t *list) {
+    for (unsigned i = 0; i < list->length; i++) {
+        strvec_clear(&list->items[i].tokens);
+    }
+    free(list->items);
+    list->items = NULL;
+    list->length = 0;
+}
+
+// The commands dispatched by run_list_command() in swish.c
+static const char *builtins[] = {
+    "bg", "cancel", "cd", "coproc", "copy", "every", "exit", "export", "fg", "history", "jobs",
+    "memstats", "pwd", "recv", "send", "set", "stats", "unset", "wait-all", "wait-for", "xargs",
+};
+#define NUM_BUILTINS (sizeof(builtins) / sizeof(builtins[0]))
+
+const char *builtin_name(unsigned i) {
+    return i < NUM_BUILTINS ? builtins[i] : NULL;
+}
+
+int is_builtin(const char *name) {
+    for (unsigned i = 0; i < NUM_BUILTINS; i++) {
+        if (strcmp(builtins[i], name) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int job_exit_status(int status) {
+    if (WIFEXITED(status)) {
+        return WEXITSTATUS(status);
+    } else if (WIFSIGNALED(status)) {
+        return 128 + WTERMSIG(status);
+    } else if (WIFSTOPPED(status)) {
+        return 128 + WSTOPSIG(status);
+    }
+    return 0;
+}
+
+// Restore the signal handlers for SIGTTOU and SIGTTIN to their defaults.
+// The code in main() within swish.c sets these handlers to the SIG_IGN value.
+static void restore_default_signals(void) {
+    struct sigaction sa;
+    sa.sa_handler = SIG_DFL;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0;
+    sigaction(SIGTTOU, &sa, NULL);
+    sigaction(SIGTTIN, &sa, NULL);
+}
+
+// Where a failed exec is reported in a child started with exec_report_child()
+static int exec_report_fd = -1;
+
+int exec_report_open(int fds[2]) {
+    return pipe2(fds, O_CLOEXEC | O_NONBLOCK);
+}
+
+void exec_report_child(int fds[2]) {
+    if (fds[0] != -1) {
+        close(fds[0]);
+    }
+    exec_report_fd = fds[1];
+}
+
+void exec_report_failure(int err) {
+    if (exec_report_fd != -1 && write(exec_report_fd, &err, sizeof(err)) == -1) {
+        perror("write");
+    }
+}
+
+int exec_report_check(int fd) {
+    if (fd == -1) {
+        return 0;
+    }
+    int err;
+    ssize_t n;
+    while ((n = read(fd, &err, sizeof(err))) == -1 && errno == EINTR) {
+    }
+    close(fd);
+    return n > 0;
+}
+
+// Run a file the kernel can't execute, such as a script without a "#!" line, with /bin/sh,
+// as execvp() does. Only returns on error.
+static void exec_script(const char *file, char **args, char **envp) {
+    int argc = 0;
+    while (args[argc] != NULL) {
+        argc++;
+    }
+    char **sh_args = malloc((argc + 2) * sizeof(char *));
+    if (sh_args == NULL) {
+        errno = ENOEXEC;
+        return;
+    }
+    sh_args[0] = "sh";
+    sh_args[1] = (char *) file;
+    memcpy(sh_args + 2, args + 1, argc * sizeof(char *));
+    execve("/bin/sh", sh_args, envp);
+    free(sh_args);
+}
+
+// Search PATH ourselves so that changes made with "export PATH=..." take effect
+void exec_program(char **args) {
+    char **envp = vars_environ();
+    if (strchr(args[0], '/') != NULL) {
+        execve(args[0], args, envp);
+        if (errno == ENOEXEC) {
+            exec_script(args[0], args, envp);
+        }
+        return;
+    }
+
+    const char *path = vars_get("PATH");
+    if (path == NULL) {
+        path = DEFAULT_PATH;
+    }
+
+    int saw_eacces = 0;
+    char candidate[PATH_MAX];
+    const char *dir = path;
+    while (1) {
+        const char *end = strchrnul(dir, ':');
+        int dir_len = end - dir;
+        // An empty PATH entry stands for the current directory
+        int len = dir_len == 0 ? snprintf(candidate, sizeof(candidate), "%s", args[0])
+                               : snprintf(candidate, sizeof(candidate), "%.*s/%s", dir_len, dir,
+                                          args[0]);
+        if (len < sizeof(candidate)) {
+            execve(candidate, args, envp);
+            if (errno == ENOEXEC) {
+                exec_script(candidate, args, envp);
+                return;
+            } else if (errno == EACCES) {
+                saw_eacces = 1;
+            } else if (errno != ENOENT && errno != ENOTDIR) {
+                return;
+            }
+        }
+
+        if (*end == '\0') {
+            break;
+        }
+        dir = end + 1;
+    }
+    errno = saw_eacces ? EACCES : ENOENT;
+}
+
+// Perform any input/output redirection in 'tokens', then exec() the specified program (token 0)
+// with the remaining command-line arguments. Shared by simple commands and external pipeline stages
+static int exec_command(strvec_t *tokens) {
+    // Build a string array from the 'tokens' vector and pass this into exec_program()
+    char **args = malloc((tokens->length + 1) * sizeof(char *));
+    if (args == NULL) {
+        perror("malloc");
+        return -1;
+    }
     int input_fd = -1;
     int output_fd = -1;
 
@@ -135,22 +478,6 @@ int run_command(strvec_t *tokens) {
         }
     }
 
-    // Restore the signal handlers for SIGTTOU and SIGTTIN to their defaults.
-    // The code in main() within swish.c sets these handlers to the SIG_IGN value.
-    // Adapt this code to use sigaction() to set the handlers to the SIG_DFL value.
-    struct sigaction sa;
-    sa.sa_handler = SIG_DFL;
-    sigemptyset(&sa.sa_mask);
-    sa.sa_flags = 0;
-    sigaction(SIGTTOU, &sa, NULL);
-    sigaction(SIGTTIN, &sa, NULL);
-
-    // Change the process group of this process (a child of the main shell).
-    // Call getpid() to get its process ID then
-    pid_t pid = getpid();
-    // call setpgid() and use this processID as the value for the new process group ID
-    setpgid(pid, pid);
-
     // Build argument list, skipping redirection operators and filenames
     int arg_count = 0;
     for (int i = 0; i < tokens->length; i++) {
@@ -169,12 +496,402 @@ int run_command(strvec_t *tokens) {
     args[arg_count] = NULL;
 
     // Execute the command
-    execvp(args[0], args);
+    exec_program(args);
 
-    // If execvp() fails, print an error message
+    // If exec_program() fails, print an error message
+    int err = errno;
     perror("exec");
-    exit(EXIT_FAILURE);
+    exec_report_failure(err);
+    exit(EXEC_FAILED_STATUS);
+
+    return 0;
+}
 
+// External stages of the pipeline run by this process, for the SIGTSTP handler
+static pid_t *pipeline_pids;
+static int pipeline_num_stages;
+
+// On ^Z, stop this process only once every external stage has stopped (or exited) as well.
+// Otherwise the shell could see the pipeline as stopped and take back the terminal while one
+// of the stages is still running and able to read the user's next command. A stage that
+// ignores SIGTSTP never stops, so the wait is bounded.
+static void pipeline_stop_handler(int sig) {
+    int saved_errno = errno;
+    struct timespec pause = {0, 1000000};
+    for (int waited_ms = 0; waited_ms < PIPELINE_STOP_WAIT_MS; waited_ms++) {
+        int running = 0;
+        for (int i = 0; i < pipeline_num_stages; i++) {
+            if (pipeline_pids[i] > 0) {
+                siginfo_t info;
+                info.si_pid = 0;
+                int result = waitid(P_PID, pipeline_pids[i], &info,
+                                    WSTOPPED | WEXITED | WNOWAIT | WNOHANG);
+                if ((result == 0 && info.si_pid == 0) || (result == -1 && errno == EINTR)) {
+                    running = 1;
+                }
+            }
+        }
+        if (!running) {
+            break;
+        }
+        nanosleep(&pause, NULL);
+    }
+    kill(getpid(), SIGSTOP);
+    errno = saved_errno;
+}
+
+static void *filter_thread(void *arg) {
+    filter_stage_t *stage = arg;
+    stage->status = filter_run(&stage->filter, &stage->in, &stage->out);
+
+    // Let the neighbouring stages see end-of-input / a closed reader
+    if (stage->in.ring != NULL) {
+        ring_close_read(stage->in.ring);
+    } else if (stage->in.fd != STDIN_FILENO) {
+        close(stage->in.fd);
+    }
+    if (stage->out.ring != NULL) {
+        ring_close_write(stage->out.ring);
+    } else if (stage->out.fd != STDOUT_FILENO) {
+        close(stage->out.fd);
+    }
+    return NULL;
+}
+
+// Run a pipeline such as "cat big.txt | grep x | wc -l". Stages that are supported builtin filters
+// run as threads of this process, connected to each other by in-memory ring buffers. Kernel pipes
+// and child processes are only used for external commands. Every process involved stays in this
+// process's group, so the pipeline is still a single job for the shell.
+// Exits with the status of the last stage, or returns -1 on error
+static int run_pipeline(strvec_t *tokens) {
+    int num_stages = 1;
+    for (int i = 0; i < tokens->length; i++) {
+        if (strcmp(tokens->data[i], "|") == 0) {
+            num_stages++;
+        }
+    }
+
+    strvec_t *stages = calloc(num_stages, sizeof(strvec_t));
+    filter_stage_t *filters = calloc(num_stages, sizeof(filter_stage_t));
+    int *is_filter = calloc(num_stages, sizeof(int));
+    pid_t *pids = calloc(num_stages, sizeof(pid_t));
+    pipeline_link_t *links = calloc(num_stages, sizeof(pipeline_link_t));
+    if (stages == NULL || filters == NULL || is_filter == NULL || pids == NULL || links == NULL) {
+        perror("calloc");
+        return -1;
+    }
+
+    int stage = 0;
+    strvec_init(&stages[0]);
+    for (int i = 0; i < tokens->length; i++) {
+        if (strcmp(tokens->data[i], "|") == 0) {
+            strvec_init(&stages[++stage]);
+        } else if (strvec_add(&stages[stage], tokens->data[i]) == -1) {
+            perror("strvec_add");
+            return -1;
+        }
+    }
+
+    for (int i = 0; i < num_stages; i++) {
+        if (stages[i].length == 0) {
+            fprintf(stderr, "Invalid pipeline: empty command\n");
+            return -1;
+        }
+        // Stages with their own redirections are left to the real program
+        int has_redirect = strvec_find(&stages[i], "<") != -1 ||
+                           strvec_find(&stages[i], ">") != -1 ||
+                           strvec_find(&stages[i], ">>") != -1;
+        is_filter[i] = !has_redirect && filter_prepare(&stages[i], &filters[i].filter) == 0;
+    }
+
+    // Connect adjacent stages: a ring buffer between two filters, a pipe otherwise
+    for (int i = 0; i < num_stages - 1; i++) {
+        if (is_filter[i] && is_filter[i + 1]) {
+            if (ring_init(&links[i].ring, RING_CAPACITY) == -1) {
+                perror("ring_init");
+                return -1;
+            }
+            links[i].is_ring = 1;
+        } else if (pipe2(links[i].fds, O_CLOEXEC) == -1) {
+            perror("pipe");
+            return -1;
+        }
+    }
+
+    // Filter threads report a closed reader through write() errors, not a signal
+    struct sigaction sa;
+    sa.sa_handler = SIG_IGN;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0;
+    sigaction(SIGPIPE, &sa, NULL);
+
+    pipeline_pids = pids;
+    pipeline_num_stages = num_stages;
+    sa.sa_handler = pipeline_stop_handler;
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGTSTP, &sa, NULL);
+
+    // Start external stages before any threads exist so the children fork from a
+    // single-threaded process
+    for (int i = 0; i < num_stages; i++) {
+        if (is_filter[i]) {
+            continue;
+        }
+        int in_fd = i == 0 ? STDIN_FILENO : links[i - 1].fds[0];
+        int out_fd = i == num_stages - 1 ? STDOUT_FILENO : links[i].fds[1];
+
+        pids[i] = fork();
+        if (pids[i] == -1) {
+            perror("fork");
+            return -1;
+        } else if (pids[i] == 0) {
+            sa.sa_handler = SIG_DFL;
+            sa.sa_flags = 0;
+            sigaction(SIGPIPE, &sa, NULL);
+            sigaction(SIGTSTP, &sa, NULL);
+            if ((in_fd != STDIN_FILENO && dup2(in_fd, STDIN_FILENO) == -1) ||
+                (out_fd != STDOUT_FILENO && dup2(out_fd, STDOUT_FILENO) == -1)) {
+                perror("dup2");
+                exit(EXIT_FAILURE);
+            }
+            exec_command(&stages[i]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Close the pipe ends that belong to external stages; filter threads close their own
+    for (int i = 0; i < num_stages - 1; i++) {
+        if (links[i].is_ring) {
+            continue;
+        }
+        if (!is_filter[i]) {
+            close(links[i].fds[1]);
+        }
+        if (!is_filter[i + 1]) {
+            close(links[i].fds[0]);
+        }
+    }
+
+    for (int i = 0; i < num_stages; i++) {
+        if (!is_filter[i]) {
+            continue;
+        }
+        filter_stage_t *f = &filters[i];
+        f->in.ring = NULL;
+        f->in.fd = STDIN_FILENO;
+        if (i > 0) {
+            if (links[i - 1].is_ring) {
+                f->in.ring = &links[i - 1].ring;
+            } else {
+                f->in.fd = links[i - 1].fds[0];
+            }
+        }
+        f->out.ring = NULL;
+        f->out.fd = STDOUT_FILENO;
+        if (i < num_stages - 1) {
+            if (links[i].is_ring) {
+                f->out.ring = &links[i].ring;
+            } else {
+                f->out.fd = links[i].fds[1];
+            }
+        }
+        if ((errno = pthread_create(&f->thread, NULL, filter_thread, f)) != 0) {
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    int last_status = 0;
+    for (int i = 0; i < num_stages; i++) {
+        int status;
+        if (is_filter[i]) {
+            pthread_join(filters[i].thread, NULL);
+            status = filters[i].status;
+        } else if (waitpid(pids[i], &status, 0) == -1) {
+            perror("waitpid");
+            status = 1;
+        } else if (WIFEXITED(status)) {
+            status = WEXITSTATUS(status);
+        } else {
+            status = 128 + WTERMSIG(status);
+        }
+        if (i == num_stages - 1) {
+            last_status = status;
+        }
+    }
+    // Skip stdio cleanup: any buffered output belongs to the shell we forked from
+    _exit(last_status);
+}
+
+// Execute the specified program (token 0) with the specified command-line arguments and perform
+// output redirection before exec()'ing, or run a pipeline if the command contains "|"
+// THIS FUNCTION SHOULD BE CALLED FROM A CHILD OF THE MAIN SHELL PROCESS
+int run_command(strvec_t *tokens) {
+    // No command entered, return error
+    if (tokens->length == 0) {
+        return -1;
+    }
+
+    restore_default_signals();
+
+    // Change the process group of this process (a child of the main shell).
+    // Call getpid() to get its process ID then
+    pid_t pid = getpid();
+    // call setpgid() and use this processID as the value for the new process group ID
+    setpgid(pid, pid);
+
+    if (strvec_find(tokens, "|") != -1) {
+        return run_pipeline(tokens);
+    }
+    return exec_command(tokens);
+}
+
+int procsub_prepare(strvec_t *tokens, procsub_list_t *subs) {
+    subs->data = NULL;
+    subs->length = 0;
+
+    for (int i = 0; i < tokens->length; i++) {
+        const char *token = tokens->data[i];
+        size_t len = strlen(token);
+        if (len < 3 || (token[0] != '<' && token[0] != '>') || token[1] != '(' ||
+            token[len - 1] != ')') {
+            continue;
+        }
+
+        procsub_t *grown = realloc(subs->data, (subs->length + 1) * sizeof(procsub_t));
+        if (grown == NULL) {
+            perror("realloc");
+            procsub_release(subs, 0);
+            return -1;
+        }
+        subs->data = grown;
+
+        procsub_t *sub = &subs->data[subs->length];
+        int fds[2];
+        if (pipe2(fds, O_CLOEXEC) == -1) {
+            perror("pipe");
+            procsub_release(subs, 0);
+            return -1;
+        }
+        sub->is_input = token[0] == '<';
+        sub->outer_fd = sub->is_input ? fds[0] : fds[1];
+        sub->inner_fd = sub->is_input ? fds[1] : fds[0];
+        sub->command = strndup(token + 2, len - 3);
+        subs->length++;
+
+        // The outer command inherits its end of the pipe across exec()
+        char path[32];
+        snprintf(path, sizeof(path), "/dev/fd/%d", sub->outer_fd);
+        if (sub->command == NULL || fcntl(sub->outer_fd, F_SETFD, 0) == -1 ||
+            strvec_set(tokens, i, path) == -1) {
+            perror("procsub_prepare");
+            procsub_release(subs, 0);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Process substitutions started by the shell and not yet collected
+static pid_t *procsub_pids;
+static unsigned num_procsub_pids;
+static unsigned procsub_pids_capacity;
+
+int procsub_spawn(procsub_list_t *subs, pid_t pgid) {
+    for (int i = 0; i < subs->length; i++) {
+        procsub_t *sub = &subs->data[i];
+        pid_t pid = fork();
+        if (pid == -1) {
+            perror("fork");
+            return -1;
+        } else if (pid == 0) {
+            // Join the outer command's process group so the substitution is part of its job
+            if (setpgid(0, pgid) == -1) {
+                perror("setpgid");
+            }
+            restore_default_signals();
+
+            int target = sub->is_input ? STDOUT_FILENO : STDIN_FILENO;
+            if (dup2(sub->inner_fd, target) == -1) {
+                perror("dup2");
+                exit(EXIT_FAILURE);
+            }
+            for (int j = 0; j < subs->length; j++) {
+                close(subs->data[j].outer_fd);
+                close(subs->data[j].inner_fd);
+            }
+
+            strvec_t inner;
+            strvec_init(&inner);
+            if (tokenize(sub->command, &inner) == -1) {
+                exit(EXIT_FAILURE);
+            }
+            if (strvec_find(&inner, "|") != -1) {
+                run_pipeline(&inner);
+            } else {
+                exec_command(&inner);
+            }
+            exit(EXIT_FAILURE);
+        }
+
+        // Set the group from both sides to avoid racing with the child's exec()
+        if (setpgid(pid, pgid) == -1 && errno != EACCES) {
+            perror("setpgid");
+        }
+
+        if (num_procsub_pids == procsub_pids_capacity) {
+            unsigned capacity = procsub_pids_capacity == 0 ? 8 : procsub_pids_capacity * 2;
+            pid_t *pids = realloc(procsub_pids, capacity * sizeof(pid_t));
+            if (pids == NULL) {
+                perror("realloc");
+                return -1;
+            }
+            procsub_pids = pids;
+            procsub_pids_capacity = capacity;
+        }
+        procsub_pids[num_procsub_pids++] = pid;
+    }
+    return 0;
+}
+
+void procsub_reap(void) {
+    unsigned i = 0;
+    while (i < num_procsub_pids) {
+        // 0 means still running; anything else means it is gone
+        if (waitpid(procsub_pids[i], NULL, WNOHANG) == 0) {
+            i++;
+        } else {
+            procsub_pids[i] = procsub_pids[--num_procsub_pids];
+        }
+    }
+}
+
+void procsub_release(procsub_list_t *subs, int keep_outer) {
+    for (int i = 0; i < subs->length; i++) {
+        close(subs->data[i].inner_fd);
+        if (!keep_outer) {
+            close(subs->data[i].outer_fd);
+        }
+        free(subs->data[i].command);
+    }
+    free(subs->data);
+    subs->data = NULL;
+    subs->length = 0;
+}
+
+int wait_for_job(pid_t pid, int *status) {
+    uint64_t wait_start = metrics_now();
+    if (waitpid(pid, status, WUNTRACED) == -1) {
+        return -1;
+    }
+    metrics_record(METRIC_WAIT_TIME, metrics_now() - wait_start);
+
+    // Once the job's main process has terminated, also collect its process substitutions
+    // that have finished. Those still going (e.g., "<(cat)") are left for later, so the
+    // shell never blocks on them.
+    if (!WIFSTOPPED(*status)) {
+        procsub_reap();
+    }
     return 0;
 }
 
@@ -189,6 +906,11 @@ int resume_job(strvec_t *tokens, job_list_t *jobs, int is_foreground) {
         fprintf(stderr, "Job index out of bounds\n");
         return -1;
     }
+    // A coprocess is only driven with send and recv; resuming it would lose track of it
+    if (job->status == COPROC) {
+        fprintf(stderr, "Job %d is a coprocess\n", job_index);
+        return -1;
+    }
 
     pid_t job_pid = job->pid;
     if (!is_foreground) {
@@ -217,11 +939,13 @@ int resume_job(strvec_t *tokens, job_list_t *jobs, int is_foreground) {
         }
 
         int status;
-        if (waitpid(job_pid, &status, WUNTRACED) == -1) {
+        if (wait_for_job(job_pid, &status) == -1) {
             perror("waitpid");
             return -1;
         }
 
+        metrics_job_done(job->start_ns, status);
+
         // If the job has terminated (not stopped), remove it from the 'jobs' list
         if (WIFEXITED(status) || WIFSIGNALED(status)) {
             if (job_list_remove(jobs, job_index) == -1) {
@@ -263,6 +987,12 @@ int await_background_job(strvec_t *tokens, job_list_t *jobs) {
         return -1;
     }
 
+    // A coprocess runs until its input is closed, which only happens when the shell exits
+    if (job->status == COPROC) {
+        fprintf(stderr, "Job %d is a coprocess\n", job_index);
+        return -1;
+    }
+
     // Make sure the job's status is BACKGROUND (no sense waiting for a stopped job)
     if (job->status != BACKGROUND) {
         fprintf(stderr, "Job index is for stopped process not background process\n");
@@ -272,11 +1002,13 @@ int await_background_job(strvec_t *tokens, job_list_t *jobs) {
     // Use waitpid() to wait for the job to terminate, as you have in resume_job() and
     // main().
     int status;
-    if (waitpid(job->pid, &status, WUNTRACED) == -1) {
+    if (wait_for_job(job->pid, &status) == -1) {
         perror("waitpid");
         return -1;
     }
 
+    metrics_job_done(job->start_ns, status);
+
     // If the process terminates (is not stopped by a signal) remove it from the jobs
     // list
     if (WIFEXITED(status) || WIFSIGNALED(status)) {
@@ -297,7 +1029,7 @@ int await_all_background_jobs(job_list_t *jobs) {
         // For a background job, call waitpid() with WUNTRACED.
         if (current->status == BACKGROUND) {
             int status;
-            if (waitpid(current->pid, &status, WUNTRACED) == -1) {
+            if (wait_for_job(current->pid, &status) == -1) {
                 perror("waitpid");
                 return -1;
             }
@@ -308,6 +1040,7 @@ int await_all_background_jobs(job_list_t *jobs) {
             if (WIFSTOPPED(status)) {
                 current->status = STOPPED;
             }
+            metrics_job_done(current->start_ns, status);
         }
         current = current->next;
     }
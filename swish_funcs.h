@@ -7,6 +7,48 @@
 #include "job_list.h"
 #include "string_vector.h"
 
+// Exit status of a child process whose program could not be executed, as in other shells
+#define EXEC_FAILED_STATUS 127
+
+// Program search path used when PATH is not set
+#define DEFAULT_PATH "/usr/local/bin:/usr/bin:/bin"
+
+/*
+ * A process substitution, "<(cmd)" or ">(cmd)", in a command line
+ */
+typedef struct {
+    char *command;    // The inner command, without the surrounding "<(" and ")"
+    int is_input;     // 1 for "<(cmd)", where the outer command reads cmd's output
+    int outer_fd;     // Pipe end the outer command opens as /dev/fd/N
+    int inner_fd;     // Pipe end connected to the inner command's stdout or stdin
+} procsub_t;
+
+typedef struct {
+    procsub_t *data;
+    unsigned length;
+} procsub_list_t;
+
+// When a command in a command list runs, based on the exit status of the command before it
+typedef enum {
+    LIST_ALWAYS,    // First command, or after ";" or "&"
+    LIST_AND,       // After "&&": only if the last command succeeded
+    LIST_OR,        // After "||": only if the last command failed
+} list_connector_t;
+
+typedef struct {
+    strvec_t tokens;
+    list_connector_t connector;
+    int is_background;    // Followed by "&"
+} list_item_t;
+
+/*
+ * A line of input split into commands separated by ";", "&&", "||", or "&"
+ */
+typedef struct {
+    list_item_t *items;
+    unsigned length;
+} command_list_t;
+
 /*
  * Task 0
  * Divide a string with substrings separated by a single space (" ")
@@ -19,15 +61,166 @@
  */
 int tokenize(char *s, strvec_t *tokens);
 
+/*
+ * Split a string into words at single spaces, as tokenize() does, but without
+ * substituting variables or expanding wildcards. A ';' ending a word becomes a
+ * word of its own.
+ * s: String to split, modified in place
+ * words: Vector in which to store the words. Must be initialized before this
+ *        function is called.
+ * Returns 0 on success or -1 on error
+ */
+int split_words(char *s, strvec_t *words);
+
+/*
+ * Substitute variables in words and expand the wildcard patterns among them.
+ * A word that expands to nothing is dropped.
+ * words: Words from split_words()
+ * tokens: Vector to which the expanded tokens are added
+ * Returns 0 on success or -1 on error
+ */
+int expand_words(const strvec_t *words, strvec_t *tokens);
+
+/*
+ * Split a line into a list of commands separated by ";", "&&", "||", or "&".
+ * A line may end with ";" or "&", but every other operator must sit between
+ * two commands. Each command's words are left unexpanded, so that variables
+ * and wildcards see what the commands before it did; run expand_words() on
+ * them just before the command runs.
+ * tokens: Words of the whole line, as produced by split_words()
+ * list: Filled in with the commands of the line. Free it with
+ *       command_list_free() when this function succeeds.
+ * Returns 0 on success or -1 on a syntax error or other error
+ */
+int command_list_parse(const strvec_t *tokens, command_list_t *list);
+
+/*
+ * Free the commands of a command list
+ * list: A list filled in by command_list_parse()
+ */
+void command_list_free(command_list_t *list);
+
+/*
+ * Get the name of one of the shell's builtins, the commands that
+ * run_list_command() in swish.c runs inside the shell itself
+ * i: Index of the builtin, counting from 0
+ * Returns the name, or NULL if i is past the last builtin
+ */
+const char *builtin_name(unsigned i);
+
+/*
+ * Check whether a command is one of the shell's builtins
+ * name: The command name, e.g., "cd"
+ * Returns 1 if it is a builtin or 0 otherwise
+ */
+int is_builtin(const char *name);
+
+/*
+ * Convert a process status reported by waitpid() to a shell exit status:
+ * the exit code of a process that exited, or 128 plus the signal number of
+ * one that was killed or stopped
+ * status: Status set by waitpid()
+ * Returns the exit status
+ */
+int job_exit_status(int status);
+
+/*
+ * Create a pipe through which a child reports a failed exec, before fork().
+ * Exit statuses can't tell a failed exec from a program that exited with
+ * EXEC_FAILED_STATUS itself; the pipe can. Both ends are close-on-exec and
+ * non-blocking.
+ * fds: Set to the read and write ends
+ * Returns 0 on success or -1 on error
+ */
+int exec_report_open(int fds[2]);
+
+/*
+ * In the child: close the read end and have exec_report_failure() write to
+ * the write end, which a successful exec closes
+ * fds: Pipe from exec_report_open(), or {-1, -1} to report nothing
+ */
+void exec_report_child(int fds[2]);
+
+/*
+ * In the child, after exec_program() failed: send the error to the parent
+ * err: The errno of the failed exec
+ */
+void exec_report_failure(int err);
+
+/*
+ * In the parent, once the child has terminated: check whether it, or a
+ * process it started, reported a failed exec. Closes the read end.
+ * fd: Read end of the pipe, or -1
+ * Returns 1 if an exec failed or 0 otherwise
+ */
+int exec_report_check(int fd);
+
+/*
+ * Execute a program like execvp(), but search the PATH from the shell's
+ * variable table and pass the shell's exported variables as the environment
+ * args: NULL-terminated argument list; args[0] is the program to run
+ * Doesn't return on success or returns with errno set on error
+ */
+void exec_program(char **args);
+
 /*
  * Task 2: Run a user-specified command (including arguments)
  * This should be called within a CHILD process of the shell
  * tokens: Vector containing tokens input by user into shell
  * Doesn't return on success (similar to exec) or returns -1 on error
  * Task 3: Improve this function to perform input/output redirection
+ * Commands containing "|" are run as a pipeline. Stages that are builtin filters
+ * (see filters.h) run as threads of the calling process connected by ring buffers;
+ * other stages run as child processes in the caller's process group. The caller
+ * then exits with the status of the last stage.
  */
 int run_command(strvec_t *tokens);
 
+/*
+ * Find the process substitutions in a tokenized command, create a pipe for each,
+ * and replace each "<(cmd)" or ">(cmd)" token with the "/dev/fd/N" path of the
+ * pipe end the outer command will use. Call this in the shell before fork().
+ * tokens: Tokens of the outer command, modified in place
+ * subs: Filled in with the substitutions found (possibly none)
+ * Returns 0 on success or -1 on error
+ */
+int procsub_prepare(strvec_t *tokens, procsub_list_t *subs);
+
+/*
+ * Start the inner command of each process substitution, concurrently with the
+ * outer command, as a member of the outer command's process group
+ * subs: Substitutions set up by procsub_prepare()
+ * pgid: Process group (and process ID) of the outer command
+ * Returns 0 on success or -1 on error
+ */
+int procsub_spawn(procsub_list_t *subs, pid_t pgid);
+
+/*
+ * Close the shell's copies of the process substitution pipes and free the list
+ * subs: Substitutions set up by procsub_prepare()
+ * keep_outer: 1 to leave the outer command's pipe ends open (in the child that
+ *             is about to run the outer command), 0 to close everything
+ */
+void procsub_release(procsub_list_t *subs, int keep_outer);
+
+/*
+ * Collect process substitutions started by procsub_spawn() that have exited,
+ * without waiting for any that are still running. A substitution can outlive
+ * its outer command (e.g., "echo <(sleep 3)"), so the shell calls this for
+ * each line of input as well as when a job terminates.
+ */
+void procsub_reap(void);
+
+/*
+ * Wait for a job's process to stop or terminate, like waitpid() with WUNTRACED.
+ * If it terminated, also collect any of the shell's process substitutions
+ * that have exited, without waiting for the rest.
+ * pid: Process ID of the job, which is also its process group ID
+ * status: Set to the process's status as reported by waitpid()
+ * Returns 0 on success or -1 on error
+ */
+int wait_for_job(pid_t pid, int *status);
+
 /*
  * Task 5: Resume a stopped (paused) process
  * This can be called from the shell process itself, no need for a fork()
@@ -0,0 +1,386 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#define _GNU_SOURCE
+
+#include "variables.h"
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_BUCKETS 64
+#define INITIAL_ENV_CAP 64
+
+typedef struct var {
+    char *name;
+    char *value;
+    uint32_t hash;
+    int env_index;    // Position of this variable in 'env', or -1 if not exported
+    struct var *next;
+} var_t;
+
+// Hash table of all variables, chained by bucket
+static var_t **buckets;
+static size_t num_buckets;
+static size_t num_vars;
+
+// Environment for execve(): "NAME=value" for each exported variable, followed by NULL.
+// env_owners[i] is the variable that env[i] belongs to.
+static char **env;
+static var_t **env_owners;
+static size_t env_len;
+static size_t env_cap;
+
+// FNV-1a hash of a name, which may be terminated by '\0' or limited to 'len' bytes
+static uint32_t hash_name(const char *name, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len && name[i] != '\0'; i++) {
+        hash ^= (unsigned char) name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static var_t *find_var(const char *name, size_t len, uint32_t hash) {
+    if (buckets == NULL) {
+        return NULL;
+    }
+    for (var_t *var = buckets[hash & (num_buckets - 1)]; var != NULL; var = var->next) {
+        if (var->hash == hash && strncmp(var->name, name, len) == 0 && var->name[len] == '\0') {
+            return var;
+        }
+    }
+    return NULL;
+}
+
+static int grow_buckets(void) {
+    size_t new_num = num_buckets == 0 ? INITIAL_BUCKETS : num_buckets * 2;
+    var_t **new_buckets = calloc(new_num, sizeof(var_t *));
+    if (new_buckets == NULL) {
+        perror("calloc");
+        return -1;
+    }
+    for (size_t i = 0; i < num_buckets; i++) {
+        var_t *var = buckets[i];
+        while (var != NULL) {
+            var_t *next = var->next;
+            var->next = new_buckets[var->hash & (new_num - 1)];
+            new_buckets[var->hash & (new_num - 1)] = var;
+            var = next;
+        }
+    }
+    free(buckets);
+    buckets = new_buckets;
+    num_buckets = new_num;
+    return 0;
+}
+
+// Write (or rewrite) the environment entry of an exported variable
+static int env_store(var_t *var) {
+    char *entry;
+    if (asprintf(&entry, "%s=%s", var->name, var->value) == -1) {
+        perror("asprintf");
+        return -1;
+    }
+
+    if (var->env_index == -1) {
+        if (env_len + 1 >= env_cap) {
+            size_t new_cap = env_cap == 0 ? INITIAL_ENV_CAP : env_cap * 2;
+            char **new_env = realloc(env, new_cap * sizeof(char *));
+            if (new_env == NULL) {
+                perror("realloc");
+                free(entry);
+                return -1;
+            }
+            env = new_env;
+            var_t **new_owners = realloc(env_owners, new_cap * sizeof(var_t *));
+            if (new_owners == NULL) {
+                perror("realloc");
+                free(entry);
+                return -1;
+            }
+            env_owners = new_owners;
+            env_cap = new_cap;
+        }
+        var->env_index = env_len++;
+        env[env_len] = NULL;
+    } else {
+        free(env[var->env_index]);
+    }
+    env[var->env_index] = entry;
+    env_owners[var->env_index] = var;
+    return 0;
+}
+
+// Drop a variable's environment entry, moving the last entry into its place
+static void env_remove(var_t *var) {
+    if (var->env_index == -1) {
+        return;
+    }
+    size_t last = env_len - 1;
+    free(env[var->env_index]);
+    env[var->env_index] = env[last];
+    env_owners[var->env_index] = env_owners[last];
+    env_owners[var->env_index]->env_index = var->env_index;
+    env[last] = NULL;
+    env_len--;
+    var->env_index = -1;
+}
+
+int vars_is_name(const char *name) {
+    if (!isalpha((unsigned char) name[0]) && name[0] != '_') {
+        return 0;
+    }
+    for (const char *c = name + 1; *c != '\0'; c++) {
+        if (!isalnum((unsigned char) *c) && *c != '_') {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int vars_init(char **envp) {
+    if (buckets == NULL && grow_buckets() == -1) {
+        return -1;
+    }
+    for (; *envp != NULL; envp++) {
+        // Entries that are not valid shell variables are skipped
+        vars_assign(*envp, 1);
+    }
+    return 0;
+}
+
+void vars_free(void) {
+    for (size_t i = 0; i < num_buckets; i++) {
+        var_t *var = buckets[i];
+        while (var != NULL) {
+            var_t *next = var->next;
+            free(var->name);
+            free(var->value);
+            free(var);
+            var = next;
+        }
+    }
+    for (size_t i = 0; i < env_len; i++) {
+        free(env[i]);
+    }
+    free(buckets);
+    free(env);
+    free(env_owners);
+    buckets = NULL;
+    env = NULL;
+    env_owners = NULL;
+    num_buckets = num_vars = env_len = env_cap = 0;
+}
+
+const char *vars_get(const char *name) {
+    size_t len = strlen(name);
+    var_t *var = find_var(name, len, hash_name(name, len));
+    return var != NULL ? var->value : NULL;
+}
+
+// Find a variable, adding it with an empty value if it does not exist yet
+static var_t *get_or_add_var(const char *name) {
+    if (!vars_is_name(name)) {
+        return NULL;
+    }
+
+    size_t len = strlen(name);
+    uint32_t hash = hash_name(name, len);
+    var_t *var = find_var(name, len, hash);
+    if (var != NULL) {
+        return var;
+    }
+
+    if ((num_vars + 1) * 4 > num_buckets * 3 && grow_buckets() == -1) {
+        return NULL;
+    }
+    if ((var = calloc(1, sizeof(var_t))) == NULL) {
+        perror("calloc");
+        return NULL;
+    }
+    var->name = strdup(name);
+    var->value = strdup("");
+    if (var->name == NULL || var->value == NULL) {
+        perror("strdup");
+        free(var->name);
+        free(var->value);
+        free(var);
+        return NULL;
+    }
+    var->hash = hash;
+    var->env_index = -1;
+    var->next = buckets[hash & (num_buckets - 1)];
+    buckets[hash & (num_buckets - 1)] = var;
+    num_vars++;
+    return var;
+}
+
+int vars_set(const char *name, const char *value, int export) {
+    var_t *var = get_or_add_var(name);
+    if (var == NULL) {
+        return -1;
+    }
+
+    char *copy = strdup(value);
+    if (copy == NULL) {
+        perror("strdup");
+        return -1;
+    }
+    free(var->value);
+    var->value = copy;
+
+    if (export || var->env_index != -1) {
+        return env_store(var);
+    }
+    return 0;
+}
+
+int vars_export(const char *name) {
+    var_t *var = get_or_add_var(name);
+    if (var == NULL) {
+        return -1;
+    }
+    if (var->env_index == -1) {
+        return env_store(var);
+    }
+    return 0;
+}
+
+void vars_unset(const char *name) {
+    size_t len = strlen(name);
+    uint32_t hash = hash_name(name, len);
+    if (buckets == NULL) {
+        return;
+    }
+
+    var_t **link = &buckets[hash & (num_buckets - 1)];
+    while (*link != NULL) {
+        var_t *var = *link;
+        if (var->hash == hash && strcmp(var->name, name) == 0) {
+            env_remove(var);
+            *link = var->next;
+            free(var->name);
+            free(var->value);
+            free(var);
+            num_vars--;
+            return;
+        }
+        link = &var->next;
+    }
+}
+
+int vars_assign(const char *assignment, int export) {
+    const char *equals = strchr(assignment, '=');
+    if (equals == NULL || equals == assignment) {
+        return -1;
+    }
+
+    char *name = strndup(assignment, equals - assignment);
+    if (name == NULL) {
+        perror("strndup");
+        return -1;
+    }
+    int result = -1;
+    if (vars_is_name(name)) {
+        result = vars_set(name, equals + 1, export);
+    }
+    free(name);
+    return result;
+}
+
+char **vars_environ(void) {
+    static char *empty_env[] = {NULL};
+    return env != NULL ? env : empty_env;
+}
+
+void vars_print(int exported_only) {
+    for (size_t i = 0; i < num_buckets; i++) {
+        for (var_t *var = buckets[i]; var != NULL; var = var->next) {
+            if (!exported_only || var->env_index != -1) {
+                printf("%s=%s\n", var->name, var->value);
+            }
+        }
+    }
+}
+
+// Append 'n' bytes of 's' to a growing, '\0'-terminated string
+static int append(char **buf, size_t *len, size_t *cap, const char *s, size_t n) {
+    if (*len + n + 1 > *cap) {
+        size_t new_cap = *cap * 2;
+        while (new_cap < *len + n + 1) {
+            new_cap *= 2;
+        }
+        char *grown = realloc(*buf, new_cap);
+        if (grown == NULL) {
+            perror("realloc");
+            return -1;
+        }
+        *buf = grown;
+        *cap = new_cap;
+    }
+    memcpy(*buf + *len, s, n);
+    *len += n;
+    (*buf)[*len] = '\0';
+    return 0;
+}
+
+char *vars_expand(const char *word) {
+    size_t cap = strlen(word) + 1;
+    size_t len = 0;
+    char *result = malloc(cap);
+    if (result == NULL) {
+        perror("malloc");
+        return NULL;
+    }
+    result[0] = '\0';
+
+    const char *c = word;
+    while (*c != '\0') {
+        const char *name = NULL;
+        size_t name_len = 0;
+        const char *next = c + 1;
+
+        if (c[0] == '\\' && c[1] == '$') {
+            next = c + 2;
+            c++;
+        } else if (c[0] == '$' && c[1] == '{') {
+            const char *close = strchr(c + 2, '}');
+            if (close != NULL && close > c + 2) {
+                name = c + 2;
+                name_len = close - name;
+                next = close + 1;
+                for (size_t i = 0; i < name_len; i++) {
+                    if (!(isalnum((unsigned char) name[i]) || name[i] == '_') ||
+                        (i == 0 && isdigit((unsigned char) name[i]))) {
+                        name = NULL;
+                        next = c + 1;
+                        break;
+                    }
+                }
+            }
+        } else if (c[0] == '$' && (isalpha((unsigned char) c[1]) || c[1] == '_')) {
+            name = c + 1;
+            while (isalnum((unsigned char) name[name_len]) || name[name_len] == '_') {
+                name_len++;
+            }
+            next = name + name_len;
+        }
+
+        int status;
+        if (name != NULL) {
+            var_t *var = find_var(name, name_len, hash_name(name, name_len));
+            status = var == NULL ? 0 : append(&result, &len, &cap, var->value, strlen(var->value));
+        } else {
+            status = append(&result, &len, &cap, c, 1);
+        }
+        if (status == -1) {
+            free(result);
+            return NULL;
+        }
+        c = next;
+    }
+    return result;
+}
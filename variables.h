@@ -0,0 +1,94 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef VARIABLES_H
+#define VARIABLES_H
+
+/*
+ * The shell's variable table. Variables live in a hash table, and exported
+ * variables are also kept in a ready-made "NAME=value" array that is passed
+ * straight to execve(). That array is patched in place whenever an exported
+ * variable changes, so starting a program never rebuilds the environment.
+ */
+
+/*
+ * Initialize the variable table, importing every entry of the given
+ * environment as an exported variable
+ * envp: NULL-terminated array of "NAME=value" strings, e.g., environ
+ * Returns 0 on success or -1 on error
+ */
+int vars_init(char **envp);
+
+/*
+ * Free all variables and the cached environment
+ */
+void vars_free(void);
+
+/*
+ * Look up the value of a variable
+ * name: Name of the variable
+ * Returns the value (not a copy) or NULL if the variable is not set
+ */
+const char *vars_get(const char *name);
+
+/*
+ * Set a variable, creating it if needed
+ * name: Name of the variable, which must be a valid identifier
+ * value: New value for the variable
+ * export: 1 to also export the variable to programs the shell starts, 0 to
+ *         keep its current export status (new variables are not exported)
+ * Returns 0 on success or -1 on error
+ */
+int vars_set(const char *name, const char *value, int export);
+
+/*
+ * Export an existing variable, or create an empty exported variable
+ * name: Name of the variable
+ * Returns 0 on success or -1 on error
+ */
+int vars_export(const char *name);
+
+/*
+ * Remove a variable from the table and from the environment
+ * name: Name of the variable
+ */
+void vars_unset(const char *name);
+
+/*
+ * Handle a "NAME=value" assignment word
+ * assignment: The word to parse, e.g., "EDITOR=vi"
+ * export: As for vars_set()
+ * Returns 0 on success or -1 if the word is not a valid assignment or on error
+ */
+int vars_assign(const char *assignment, int export);
+
+/*
+ * Check whether a string is a valid variable name: a letter or '_'
+ * followed by letters, digits, and '_'
+ * name: The string to check
+ * Returns 1 if it is valid, 0 otherwise
+ */
+int vars_is_name(const char *name);
+
+/*
+ * Get the environment to pass to execve()
+ * Returns a NULL-terminated array of "NAME=value" strings owned by the table
+ */
+char **vars_environ(void);
+
+/*
+ * Print variables, one "NAME=value" per line, in no particular order
+ * exported_only: 1 to print only exported variables, 0 to print all of them
+ */
+void vars_print(int exported_only);
+
+/*
+ * Replace every "$NAME" and "${NAME}" in a word with the variable's value.
+ * Unset variables expand to the empty string. A '$' that does not start a
+ * variable reference is kept as-is, and "\$" becomes a plain '$'.
+ * word: The word to expand
+ * Returns a newly allocated copy of the expanded word, which the caller must
+ * free, or NULL on error
+ */
+char *vars_expand(const char *word);
+
+#endif    // VARIABLES_H
@@ -0,0 +1,538 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#define _GNU_SOURCE
+
+#include "wildcard.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define GETDENTS_BUF_SIZE (1 << 20)
+#define MAX_CACHED_DIRS 64
+
+// A directory modified this recently may change again within the same timestamp
+// tick, so its listing is not trusted on the next lookup
+#define RACY_MTIME_SEC 1
+
+// Record layout returned by the getdents64 system call
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+typedef struct {
+    int used;    // 0 if this cache slot is unused
+    dev_t dev;    // The listing's key: the directory however it is named
+    ino_t ino;
+    struct timespec mtime;
+    int trusted;    // Whether the listing may be reused while mtime is unchanged
+    char *names;    // Entry names, each terminated by '\0'
+    size_t names_len;
+    size_t names_cap;
+    size_t *offsets;    // Offset of each entry's name within 'names'
+    unsigned char *types;    // d_type of each entry
+    size_t count;
+    size_t cap;
+    unsigned long last_used;
+    int pins;    // Listings in use by an expansion are never evicted
+    int cached;
+} dir_listing_t;
+
+typedef struct {
+    char **segments;
+    int num_segments;
+    int dirs_only;    // Pattern ended in '/'
+    char **results;
+    size_t num_results;
+    size_t results_cap;
+    int failed;
+} expansion_t;
+
+static dir_listing_t cache[MAX_CACHED_DIRS];
+static unsigned long cache_clock;
+static char *dirent_buf;
+
+int wildcard_is_pattern(const char *word) {
+    for (; *word != '\0'; word++) {
+        if (*word == '\\' && word[1] != '\0') {
+            word++;
+        } else if (*word == '*' || *word == '?' || *word == '[') {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void listing_clear(dir_listing_t *listing) {
+    free(listing->names);
+    free(listing->offsets);
+    free(listing->types);
+    memset(listing, 0, sizeof(*listing));
+}
+
+void wildcard_cache_free(void) {
+    for (int i = 0; i < MAX_CACHED_DIRS; i++) {
+        listing_clear(&cache[i]);
+    }
+    free(dirent_buf);
+    dirent_buf = NULL;
+}
+
+static int listing_add(dir_listing_t *listing, const char *name, unsigned char type) {
+    size_t len = strlen(name) + 1;
+    if (listing->names_len + len > listing->names_cap) {
+        size_t cap = listing->names_cap == 0 ? 4096 : listing->names_cap;
+        while (cap < listing->names_len + len) {
+            cap *= 2;
+        }
+        char *grown = realloc(listing->names, cap);
+        if (grown == NULL) {
+            return -1;
+        }
+        listing->names = grown;
+        listing->names_cap = cap;
+    }
+    if (listing->count == listing->cap) {
+        size_t cap = listing->cap == 0 ? 64 : listing->cap * 2;
+        size_t *offsets = realloc(listing->offsets, cap * sizeof(size_t));
+        if (offsets == NULL) {
+            return -1;
+        }
+        listing->offsets = offsets;
+        unsigned char *types = realloc(listing->types, cap);
+        if (types == NULL) {
+            return -1;
+        }
+        listing->types = types;
+        listing->cap = cap;
+    }
+
+    memcpy(listing->names + listing->names_len, name, len);
+    listing->offsets[listing->count] = listing->names_len;
+    listing->types[listing->count] = type;
+    listing->names_len += len;
+    listing->count++;
+    return 0;
+}
+
+// Read all entries of an open directory with raw getdents64 calls and a large buffer,
+// which needs far fewer system calls than readdir() on very large directories
+static int listing_read(dir_listing_t *listing, int fd) {
+    if (dirent_buf == NULL && (dirent_buf = malloc(GETDENTS_BUF_SIZE)) == NULL) {
+        return -1;
+    }
+
+    long nread;
+    while ((nread = syscall(SYS_getdents64, fd, dirent_buf, GETDENTS_BUF_SIZE)) > 0) {
+        for (long pos = 0; pos < nread;) {
+            struct linux_dirent64 *d = (struct linux_dirent64 *) (dirent_buf + pos);
+            pos += d->d_reclen;
+            const char *name = d->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+                continue;
+            }
+            if (listing_add(listing, name, d->d_type) == -1) {
+                return -1;
+            }
+        }
+    }
+    return nread == -1 ? -1 : 0;
+}
+
+// Choose a cache slot for a new listing: an empty one, or else the least recently
+// used listing that is not in use. Returns NULL if every slot is in use.
+static dir_listing_t *cache_victim(void) {
+    dir_listing_t *victim = NULL;
+    for (int i = 0; i < MAX_CACHED_DIRS; i++) {
+        if (!cache[i].used) {
+            return &cache[i];
+        }
+        if (cache[i].pins == 0 && (victim == NULL || cache[i].last_used < victim->last_used)) {
+            victim = &cache[i];
+        }
+    }
+    return victim;
+}
+
+// Get the listing of a directory, from the cache if the directory is unchanged. Listings are
+// found by device and inode, so a directory reached through another name (a relative path,
+// a bind mount) shares its entry, and a different directory renamed into place does not.
+// The listing stays valid until released with listing_release()
+static dir_listing_t *listing_get(const char *path) {
+    struct stat st;
+    if (stat(path, &st) == -1 || !S_ISDIR(st.st_mode)) {
+        return NULL;
+    }
+
+    dir_listing_t *slot = NULL;
+    int found = 0;
+    for (int i = 0; i < MAX_CACHED_DIRS; i++) {
+        if (cache[i].used && cache[i].dev == st.st_dev && cache[i].ino == st.st_ino) {
+            if (cache[i].trusted && cache[i].mtime.tv_sec == st.st_mtim.tv_sec &&
+                cache[i].mtime.tv_nsec == st.st_mtim.tv_nsec) {
+                cache[i].last_used = ++cache_clock;
+                cache[i].pins++;
+                return &cache[i];
+            }
+            // Stale: refresh it in place unless an expansion is still using it
+            if (cache[i].pins == 0) {
+                slot = &cache[i];
+            }
+            found = 1;
+            break;
+        }
+    }
+    if (!found) {
+        slot = cache_victim();
+    }
+
+    // Deep "**" expansions can pin every slot; fall back to an uncached listing
+    dir_listing_t *listing = slot;
+    if (listing == NULL) {
+        if ((listing = calloc(1, sizeof(dir_listing_t))) == NULL) {
+            return NULL;
+        }
+    } else {
+        listing_clear(listing);
+        listing->cached = 1;
+    }
+
+    int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd == -1 || fstat(fd, &st) == -1 || listing_read(listing, fd) == -1) {
+        if (fd != -1) {
+            close(fd);
+        }
+        int cached = listing->cached;
+        listing_clear(listing);
+        if (!cached) {
+            free(listing);
+        }
+        return NULL;
+    }
+    close(fd);
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    listing->used = 1;
+    listing->dev = st.st_dev;
+    listing->ino = st.st_ino;
+    listing->mtime = st.st_mtim;
+    listing->trusted = now.tv_sec - st.st_mtim.tv_sec > RACY_MTIME_SEC;
+    listing->last_used = ++cache_clock;
+    listing->pins = 1;
+    return listing;
+}
+
+static void listing_release(dir_listing_t *listing) {
+    listing->pins--;
+    if (!listing->cached) {
+        listing_clear(listing);
+        free(listing);
+    }
+}
+
+// Match one character of a name against the pattern element at *pattern, which is
+// advanced past the element on success
+static int match_char(const char **pattern, char c) {
+    const char *p = *pattern;
+    if (*p == '?') {
+        *pattern = p + 1;
+        return 1;
+    }
+
+    if (*p == '[') {
+        const char *q = p + 1;
+        int negate = 0;
+        if (*q == '!' || *q == '^') {
+            negate = 1;
+            q++;
+        }
+        int matched = 0;
+        int first = 1;
+        while (*q != '\0' && (*q != ']' || first)) {
+            char lo = *q;
+            if (lo == '\\' && q[1] != '\0') {
+                lo = *++q;
+            }
+            char hi = lo;
+            if (q[1] == '-' && q[2] != ']' && q[2] != '\0') {
+                hi = q[2];
+                q += 2;
+            }
+            if (c >= lo && c <= hi) {
+                matched = 1;
+            }
+            q++;
+            first = 0;
+        }
+        if (*q == ']') {
+            if (matched == negate) {
+                return 0;
+            }
+            *pattern = q + 1;
+            return 1;
+        }
+        // No closing ']': treat the '[' as an ordinary character
+    }
+
+    if (*p == '\\' && p[1] != '\0') {
+        p++;
+    }
+    if (*p != c) {
+        return 0;
+    }
+    *pattern = p + 1;
+    return 1;
+}
+
+// Match a single path component against a pattern component. Backtracks to the
+// most recent '*' only, so the cost is linear in practice.
+static int match_name(const char *pattern, const char *name) {
+    if (name[0] == '.' && pattern[0] != '.') {
+        return 0;
+    }
+
+    const char *star_p = NULL;
+    const char *star_n = NULL;
+    while (*name != '\0') {
+        if (*pattern == '*') {
+            while (*pattern == '*') {
+                pattern++;
+            }
+            star_p = pattern;
+            star_n = name;
+        } else if (*pattern != '\0' && match_char(&pattern, *name)) {
+            name++;
+        } else if (star_p != NULL) {
+            pattern = star_p;
+            name = ++star_n;
+        } else {
+            return 0;
+        }
+    }
+    while (*pattern == '*') {
+        pattern++;
+    }
+    return *pattern == '\0';
+}
+
+static void add_result(expansion_t *exp, const char *path, size_t len) {
+    if (exp->num_results == exp->results_cap) {
+        size_t cap = exp->results_cap == 0 ? 64 : exp->results_cap * 2;
+        char **grown = realloc(exp->results, cap * sizeof(char *));
+        if (grown == NULL) {
+            exp->failed = 1;
+            return;
+        }
+        exp->results = grown;
+        exp->results_cap = cap;
+    }
+    if ((exp->results[exp->num_results] = strndup(path, len)) == NULL) {
+        exp->failed = 1;
+        return;
+    }
+    exp->num_results++;
+}
+
+static int is_directory(const char *path, unsigned char type) {
+    if (type == DT_DIR) {
+        return 1;
+    } else if (type != DT_LNK && type != DT_UNKNOWN) {
+        return 0;
+    }
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+// Append a name (and optionally a '/') to the path buffer
+// Returns the new length, or 0 if the path would be too long
+static size_t path_append(char *path, size_t len, const char *name, int slash) {
+    size_t name_len = strlen(name);
+    if (len + name_len + 2 > PATH_MAX) {
+        return 0;
+    }
+    memcpy(path + len, name, name_len);
+    len += name_len;
+    if (slash) {
+        path[len++] = '/';
+    }
+    path[len] = '\0';
+    return len;
+}
+
+static void expand_from(expansion_t *exp, char *path, size_t len, int seg);
+
+// A full match has been built in 'path'
+static void finish_match(expansion_t *exp, char *path, size_t len, unsigned char type) {
+    if (exp->dirs_only) {
+        if (!is_directory(path, type)) {
+            return;
+        }
+        path[len++] = '/';
+    }
+    add_result(exp, path, len);
+}
+
+// "**": match zero or more directory levels (symbolic links are not followed)
+static void expand_globstar(expansion_t *exp, char *path, size_t len, int seg) {
+    int last = seg == exp->num_segments - 1;
+    if (!last) {
+        expand_from(exp, path, len, seg + 1);
+    }
+
+    dir_listing_t *listing = listing_get(len == 0 ? "." : path);
+    if (listing == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < listing->count && !exp->failed; i++) {
+        const char *name = listing->names + listing->offsets[i];
+        size_t sub_len;
+        if (name[0] == '.' || (sub_len = path_append(path, len, name, 0)) == 0) {
+            continue;
+        }
+        if (last) {
+            finish_match(exp, path, sub_len, listing->types[i]);
+        }
+        if (listing->types[i] == DT_DIR ||
+            (listing->types[i] == DT_UNKNOWN && is_directory(path, DT_UNKNOWN))) {
+            path[sub_len++] = '/';
+            path[sub_len] = '\0';
+            expand_globstar(exp, path, sub_len, seg);
+        }
+    }
+    path[len] = '\0';
+    listing_release(listing);
+}
+
+// Expand pattern segments seg..end relative to the directory prefix in 'path'
+static void expand_from(expansion_t *exp, char *path, size_t len, int seg) {
+    if (seg == exp->num_segments) {
+        finish_match(exp, path, len, DT_UNKNOWN);
+        return;
+    }
+
+    const char *pattern = exp->segments[seg];
+    int last = seg == exp->num_segments - 1;
+
+    if (strcmp(pattern, "**") == 0) {
+        expand_globstar(exp, path, len, seg);
+        return;
+    }
+
+    // A literal component: no need to list the directory
+    if (!wildcard_is_pattern(pattern)) {
+        size_t sub_len = len;
+        for (const char *p = pattern; *p != '\0'; p++) {
+            if (*p == '\\' && p[1] != '\0') {
+                p++;
+            }
+            if (sub_len + 2 >= PATH_MAX) {
+                return;
+            }
+            path[sub_len++] = *p;
+        }
+        path[sub_len] = '\0';
+
+        struct stat st;
+        if (lstat(path, &st) == 0) {
+            if (last) {
+                finish_match(exp, path, sub_len, DT_UNKNOWN);
+            } else {
+                path[sub_len++] = '/';
+                path[sub_len] = '\0';
+                expand_from(exp, path, sub_len, seg + 1);
+            }
+        }
+        path[len] = '\0';
+        return;
+    }
+
+    dir_listing_t *listing = listing_get(len == 0 ? "." : path);
+    if (listing == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < listing->count && !exp->failed; i++) {
+        const char *name = listing->names + listing->offsets[i];
+        if (!match_name(pattern, name)) {
+            continue;
+        }
+        size_t sub_len = path_append(path, len, name, 0);
+        if (sub_len == 0) {
+            continue;
+        }
+        if (last) {
+            finish_match(exp, path, sub_len, listing->types[i]);
+        } else if (is_directory(path, listing->types[i])) {
+            path[sub_len++] = '/';
+            path[sub_len] = '\0';
+            expand_from(exp, path, sub_len, seg + 1);
+        }
+    }
+    path[len] = '\0';
+    listing_release(listing);
+}
+
+static int compare_paths(const void *a, const void *b) {
+    return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+int wildcard_expand(const char *pattern, strvec_t *matches) {
+    char *copy = strdup(pattern);
+    char **segments = malloc((strlen(pattern) / 2 + 2) * sizeof(char *));
+    char *path = malloc(PATH_MAX);
+    if (copy == NULL || segments == NULL || path == NULL) {
+        free(copy);
+        free(segments);
+        free(path);
+        return -1;
+    }
+
+    expansion_t exp;
+    memset(&exp, 0, sizeof(exp));
+    exp.segments = segments;
+    exp.dirs_only = pattern[strlen(pattern) - 1] == '/';
+    char *saveptr;
+    for (char *seg = strtok_r(copy, "/", &saveptr); seg != NULL;
+         seg = strtok_r(NULL, "/", &saveptr)) {
+        exp.segments[exp.num_segments++] = seg;
+    }
+
+    size_t len = 0;
+    if (pattern[0] == '/') {
+        path[len++] = '/';
+    }
+    path[len] = '\0';
+    expand_from(&exp, path, len, 0);
+
+    int status = 0;
+    qsort(exp.results, exp.num_results, sizeof(char *), compare_paths);
+    for (size_t i = 0; i < exp.num_results; i++) {
+        if (!exp.failed && strvec_add(matches, exp.results[i]) == -1) {
+            exp.failed = 1;
+        }
+        free(exp.results[i]);
+    }
+    if (exp.failed) {
+        status = -1;
+    } else {
+        status = exp.num_results;
+    }
+
+    free(exp.results);
+    free(copy);
+    free(segments);
+    free(path);
+    return status;
+}
@@ -0,0 +1,34 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef WILDCARD_H
+#define WILDCARD_H
+
+#include "string_vector.h"
+
+/*
+ * Check whether a word contains any unescaped wildcard characters ('*', '?'
+ * or '[') and so should be expanded
+ * word: The word to check
+ * Returns 1 if the word is a pattern, 0 otherwise
+ */
+int wildcard_is_pattern(const char *word);
+
+/*
+ * Expand a pattern into the sorted list of existing paths it matches.
+ * Supports '*', '?', bracket expressions ("[a-z]", "[!0-9]") and "**", which
+ * matches any number of directory levels. As in other shells, wildcards do
+ * not match a leading '.' unless the pattern has one.
+ * Directory listings are read with getdents64() and cached per directory
+ * until the directory's modification time changes.
+ * pattern: The pattern to expand, e.g., "*.txt" or "src/[a-m]*.c"
+ * matches: Vector to append the matching paths to
+ * Returns the number of paths appended (0 if nothing matched) or -1 on error
+ */
+int wildcard_expand(const char *pattern, strvec_t *matches);
+
+/*
+ * Free all cached directory listings
+ */
+void wildcard_cache_free(void);
+
+#endif    // WILDCARD_H
@@ -0,0 +1,385 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#define _GNU_SOURCE
+
+#include "xargs.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "metrics.h"
+#include "swish_funcs.h"
+#include "variables.h"
+
+#define DEFAULT_COMMAND "echo"
+#define WAIT_POLL_NS 100000000L
+
+typedef struct {
+    pid_t pid;
+    uint64_t start_ns;
+    int exec_report_fd;    // Read end of the exec_report_open() pipe, or -1
+} batch_t;
+
+typedef struct {
+    // The command and its fixed arguments, followed by the items of the batch being built
+    char **argv;
+    unsigned argc;
+    unsigned cap;
+    unsigned command_argc;
+    size_t bytes;    // Space the arguments will take in the new program's memory
+    size_t max_bytes;
+    unsigned max_items;    // 0 for no limit other than max_bytes
+
+    batch_t *running;
+    unsigned num_running;
+    unsigned max_running;
+    job_list_t *jobs;
+    int worst_status;
+} xargs_t;
+
+static volatile sig_atomic_t interrupted;
+
+static void xargs_sigint_handler(int sig) {
+    interrupted = 1;
+}
+
+// Space an argument takes when passed to execve(): the string and its pointer
+static size_t arg_cost(const char *arg) {
+    return strlen(arg) + 1 + sizeof(char *);
+}
+
+// Space left for arguments: ARG_MAX minus what the environment takes and a safety margin
+static size_t argument_space(void) {
+    long arg_max = sysconf(_SC_ARG_MAX);
+    if (arg_max <= 0) {
+        arg_max = _POSIX_ARG_MAX;
+    }
+    size_t env_bytes = sizeof(char *);
+    for (char **env = vars_environ(); *env != NULL; env++) {
+        env_bytes += arg_cost(*env);
+    }
+    if (env_bytes + XARGS_ARG_MARGIN >= arg_max) {
+        return 0;
+    }
+    return arg_max - env_bytes - XARGS_ARG_MARGIN;
+}
+
+static void remove_job(job_list_t *jobs, pid_t pid) {
+    unsigned idx = 0;
+    for (job_t *current = jobs->head; current != NULL; current = current->next, idx++) {
+        if (current->pid == pid) {
+            job_list_remove(jobs, idx);
+            return;
+        }
+    }
+}
+
+// Collect one finished batch, blocking until one finishes
+// Returns 0 on success or -1 on error
+static int reap_batch(xargs_t *xargs, sigset_t *sigchld) {
+    struct timespec timeout = {0, WAIT_POLL_NS};
+    int forwarded = 0;
+    while (1) {
+        // Pass Ctrl-C on to the batches, which are not in the terminal's foreground group
+        if (interrupted && !forwarded) {
+            for (unsigned i = 0; i < xargs->num_running; i++) {
+                kill(-xargs->running[i].pid, SIGINT);
+            }
+            forwarded = 1;
+        }
+
+        for (unsigned i = 0; i < xargs->num_running; i++) {
+            batch_t *batch = &xargs->running[i];
+            int status;
+            pid_t pid = waitpid(batch->pid, &status, WNOHANG);
+            if (pid == -1) {
+                perror("waitpid");
+                return -1;
+            } else if (pid == 0) {
+                continue;
+            }
+
+            metrics_job_done(batch->start_ns, status);
+            if (exec_report_check(batch->exec_report_fd)) {
+                metrics_count(METRIC_EXEC_FAILURES);
+            }
+            int exit_status = job_exit_status(status);
+            if (exit_status > xargs->worst_status) {
+                xargs->worst_status = exit_status;
+            }
+            remove_job(xargs->jobs, batch->pid);
+            *batch = xargs->running[--xargs->num_running];
+            return 0;
+        }
+
+        // Sleep until a child changes state; the timeout bounds how late Ctrl-C is noticed
+        if (sigtimedwait(sigchld, NULL, &timeout) == -1 && errno != EAGAIN && errno != EINTR) {
+            perror("sigtimedwait");
+            return -1;
+        }
+    }
+}
+
+// Start the batch in xargs->argv as a background job, first waiting for a free slot
+// Returns 0 on success or -1 on error
+static int launch_batch(xargs_t *xargs, sigset_t *sigchld) {
+    while (xargs->num_running >= xargs->max_running) {
+        if (reap_batch(xargs, sigchld) == -1) {
+            return -1;
+        }
+    }
+    if (interrupted) {
+        return 0;
+    }
+    xargs->argv[xargs->argc] = NULL;
+
+    int exec_report[2] = {-1, -1};
+    if (exec_report_open(exec_report) == -1) {
+        perror("pipe2");
+    }
+
+    uint64_t start = metrics_now();
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("fork");
+        metrics_count(METRIC_FORK_FAILURES);
+        if (exec_report[0] != -1) {
+            close(exec_report[0]);
+            close(exec_report[1]);
+        }
+        return -1;
+    } else if (pid == 0) {
+        exec_report_child(exec_report);
+        if (setpgid(0, 0) == -1) {
+            perror("setpgid");
+        }
+        struct sigaction sa;
+        sa.sa_handler = SIG_DFL;
+        sigemptyset(&sa.sa_mask);
+        sa.sa_flags = 0;
+        sigaction(SIGTTOU, &sa, NULL);
+        sigaction(SIGTTIN, &sa, NULL);
+        sigaction(SIGTSTP, &sa, NULL);
+        sigprocmask(SIG_UNBLOCK, sigchld, NULL);
+
+        // Items come from our input, so the command gets none of its own
+        int null_fd = open("/dev/null", O_RDONLY);
+        if (null_fd != -1) {
+            dup2(null_fd, STDIN_FILENO);
+            close(null_fd);
+        }
+        exec_program(xargs->argv);
+        int err = errno;
+        perror("exec");
+        exec_report_failure(err);
+        _exit(EXEC_FAILED_STATUS);
+    }
+    metrics_record(METRIC_SPAWN_LATENCY, metrics_now() - start);
+    if (exec_report[1] != -1) {
+        close(exec_report[1]);
+    }
+
+    if (setpgid(pid, pid) == -1 && errno != EACCES) {
+        perror("setpgid");
+    }
+    if (job_list_add(xargs->jobs, pid, xargs->argv[0], BACKGROUND) == -1) {
+        perror("job_list_add");
+    }
+    xargs->running[xargs->num_running].pid = pid;
+    xargs->running[xargs->num_running].start_ns = start;
+    xargs->running[xargs->num_running].exec_report_fd = exec_report[0];
+    xargs->num_running++;
+
+    // Start the next batch with just the command again
+    for (unsigned i = xargs->command_argc; i < xargs->argc; i++) {
+        xargs->bytes -= arg_cost(xargs->argv[i]);
+        free(xargs->argv[i]);
+    }
+    xargs->argc = xargs->command_argc;
+    return 0;
+}
+
+// Append one item to the batch being built, launching the batch first if the item does not fit
+// Returns 0 on success or -1 on error
+static int add_item(xargs_t *xargs, const char *item, sigset_t *sigchld) {
+    size_t cost = arg_cost(item);
+    if (xargs->bytes + cost > xargs->max_bytes) {
+        if (xargs->argc == xargs->command_argc) {
+            fprintf(stderr, "xargs: Argument list too long\n");
+            return -1;
+        }
+        if (launch_batch(xargs, sigchld) == -1) {
+            return -1;
+        }
+    }
+
+    if (xargs->argc + 2 > xargs->cap) {
+        unsigned cap = xargs->cap * 2;
+        char **grown = realloc(xargs->argv, cap * sizeof(char *));
+        if (grown == NULL) {
+            perror("realloc");
+            return -1;
+        }
+        xargs->argv = grown;
+        xargs->cap = cap;
+    }
+    if ((xargs->argv[xargs->argc] = strdup(item)) == NULL) {
+        perror("strdup");
+        return -1;
+    }
+    xargs->argc++;
+    xargs->bytes += cost;
+
+    if (xargs->max_items > 0 && xargs->argc - xargs->command_argc >= xargs->max_items) {
+        return launch_batch(xargs, sigchld);
+    }
+    return 0;
+}
+
+// Parse a positive integer option value
+static int parse_count(const char *s, unsigned *value) {
+    char *end;
+    long n = strtol(s, &end, 10);
+    if (*s == '\0' || *end != '\0' || n < 1 || n > 1000000) {
+        return -1;
+    }
+    *value = n;
+    return 0;
+}
+
+int xargs_command(const strvec_t *tokens, job_list_t *jobs) {
+    xargs_t xargs;
+    memset(&xargs, 0, sizeof(xargs));
+    xargs.max_running = 1;
+    xargs.jobs = jobs;
+
+    unsigned i = 1;
+    for (; i + 1 < tokens->length; i += 2) {
+        unsigned *value;
+        if (strcmp(tokens->data[i], "-n") == 0) {
+            value = &xargs.max_items;
+        } else if (strcmp(tokens->data[i], "-P") == 0) {
+            value = &xargs.max_running;
+        } else {
+            break;
+        }
+        if (parse_count(tokens->data[i + 1], value) == -1) {
+            fprintf(stderr, "xargs: Invalid value for %s: %s\n", tokens->data[i],
+                    tokens->data[i + 1]);
+            return -1;
+        }
+    }
+
+    // The rest is the command, except for a trailing "< FILE"
+    unsigned end = tokens->length;
+    const char *input_path = NULL;
+    if (end - i >= 2 && strcmp(tokens->data[end - 2], "<") == 0) {
+        input_path = tokens->data[end - 1];
+        end -= 2;
+    }
+
+    FILE *input = stdin;
+    if (input_path != NULL && (input = fopen(input_path, "r")) == NULL) {
+        perror("Failed to open input file");
+        return -1;
+    }
+
+    xargs.max_bytes = argument_space();
+    xargs.cap = (end - i) + 16;
+    xargs.argv = malloc(xargs.cap * sizeof(char *));
+    xargs.running = malloc(xargs.max_running * sizeof(batch_t));
+    int status = 0;
+    if (xargs.argv == NULL || xargs.running == NULL) {
+        perror("malloc");
+        status = -1;
+    }
+    const char *command = end > i ? NULL : DEFAULT_COMMAND;
+    for (unsigned j = i; status == 0 && (j < end || command != NULL); j++) {
+        const char *arg = command != NULL ? command : tokens->data[j];
+        if ((xargs.argv[xargs.argc] = strdup(arg)) == NULL) {
+            perror("strdup");
+            status = -1;
+            break;
+        }
+        xargs.argc++;
+        xargs.bytes += arg_cost(arg);
+        command = NULL;
+    }
+    xargs.command_argc = xargs.argc;
+    if (status == 0 && xargs.bytes >= xargs.max_bytes) {
+        fprintf(stderr, "xargs: Argument list too long\n");
+        status = -1;
+    }
+
+    // Catch Ctrl-C to pass it on, and block SIGCHLD so reap_batch() can wait for it.
+    // The shell stays in the terminal's foreground group while the batches run, so
+    // ignore Ctrl-Z rather than stop the shell with nothing left to resume them.
+    struct sigaction sa;
+    struct sigaction old_sa;
+    struct sigaction old_tstp_sa;
+    sa.sa_handler = SIG_IGN;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0;
+    sigaction(SIGTSTP, &sa, &old_tstp_sa);
+    sa.sa_handler = xargs_sigint_handler;
+    sigset_t sigchld;
+    sigset_t old_mask;
+    sigemptyset(&sigchld);
+    sigaddset(&sigchld, SIGCHLD);
+    interrupted = 0;
+    sigaction(SIGINT, &sa, &old_sa);
+    sigprocmask(SIG_BLOCK, &sigchld, &old_mask);
+
+    char *line = NULL;
+    size_t line_cap = 0;
+    while (status == 0 && !interrupted && getline(&line, &line_cap, input) != -1) {
+        char *save;
+        for (char *item = strtok_r(line, " \t\r\n", &save); item != NULL && status == 0;
+             item = strtok_r(NULL, " \t\r\n", &save)) {
+            status = add_item(&xargs, item, &sigchld);
+        }
+    }
+    free(line);
+    if (status == 0 && xargs.argc > xargs.command_argc) {
+        status = launch_batch(&xargs, &sigchld);
+    }
+    while (xargs.num_running > 0) {
+        if (reap_batch(&xargs, &sigchld) == -1) {
+            status = -1;
+            break;
+        }
+    }
+    for (unsigned j = 0; j < xargs.num_running; j++) {
+        if (xargs.running[j].exec_report_fd != -1) {
+            close(xargs.running[j].exec_report_fd);
+        }
+    }
+
+    sigprocmask(SIG_SETMASK, &old_mask, NULL);
+    sigaction(SIGINT, &old_sa, NULL);
+    sigaction(SIGTSTP, &old_tstp_sa, NULL);
+    if (input == stdin) {
+        // Let the shell keep reading commands after the user ends the items with Ctrl-D
+        clearerr(stdin);
+    } else {
+        fclose(input);
+    }
+    for (unsigned j = 0; xargs.argv != NULL && j < xargs.argc; j++) {
+        free(xargs.argv[j]);
+    }
+    free(xargs.argv);
+    free(xargs.running);
+
+    if (status == 0 && interrupted && xargs.worst_status < 128 + SIGINT) {
+        xargs.worst_status = 128 + SIGINT;
+    }
+    return status == -1 ? -1 : xargs.worst_status;
+}
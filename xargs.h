@@ -0,0 +1,28 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef XARGS_H
+#define XARGS_H
+
+#include "job_list.h"
+#include "string_vector.h"
+
+// Bytes left free below the system's argument size limit, as POSIX recommends
+#define XARGS_ARG_MARGIN 2048
+
+/*
+ * The "xargs" builtin: xargs [-n N] [-P P] [COMMAND [ARGS...]] [< FILE]
+ * Reads whitespace-separated items from stdin (or FILE) and runs COMMAND
+ * (default: echo) with as many items appended to ARGS as fit within the
+ * system's ARG_MAX, after the space taken by the environment, or at most N
+ * items per run with -n. Up to P runs (default 1) go at once, each as a
+ * background job in its own process group with stdin from /dev/null.
+ * Nothing is run if there are no items. Ctrl-C is passed on to the running
+ * jobs and stops any more from starting; Ctrl-Z is ignored until xargs is done.
+ * tokens: Tokens typed by the user, e.g., "xargs -P 4 gzip < files.txt"
+ * jobs: The shell's job list, where running batches are listed
+ * Returns the highest exit status of any run (0 if all succeeded), or -1 on
+ * error
+ */
+int xargs_command(const strvec_t *tokens, job_list_t *jobs);
+
+#endif    // XARGS_H